@@ -0,0 +1,233 @@
+/******************************************************************************
+ *    File : bench.cpp
+ * Descrip : Benchmark of the state tree layout chosen by STATE_ENCODING.
+ *           Grows a plant, then reports bytes per node and how fast the
+ *           tree can be walked and the plant generated, whether cached
+ *           growth matches growth evaluated afresh, then how fast a ray
+ *           picks a cone and whether it agrees with testing every cone.
+ *           "make bench" builds and runs it once for each layout.
+ *****************************************************************************/
+
+/* Include files */
+#include "grow.h"
+#include "pick.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>                       /* Need math functions */
+#include <random>
+#include <stdio.h>                      /* For file operations */
+#include <stdlib.h>
+
+/* Constants */
+#define BENCH_NODES (STATE_SIZE*3/4)    /* Grow plant to about this size */
+#define BENCH_WALKS 500                 /* Timed walks of the tree */
+#define BENCH_RUNS 20                   /* Timed runs of generate */
+#define BENCH_PICKS 1000                /* Rays cast at the plant */
+
+/* Seconds on a monotonic clock */
+static double now()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Fastest and median of times, which are sorted */
+static void spread(std::vector<double> &times, double &best, double &median)
+{
+    std::sort(times.begin(), times.end());
+    best = times[0];
+    median = times[times.size()/2];
+}
+
+/* Visit every node reachable from root, decoding each one */
+static double walkTree(const plant &p)
+{
+    std::vector<int> stack(1, p.root);
+    double sum = 0;
+    while (!stack.empty())
+    {
+        int node = stack.back();
+        stack.pop_back();
+        const stored_state &ss = p.states[node];
+        state s;
+        unpackState(ss, s);
+        sum += s.size + s.deg + s.azimuth + s.mytime + s.rule;
+        int sibling = getSibling(ss), child = getChild(ss);
+        if (sibling != NONE && sibling > node)
+            stack.push_back(sibling);
+        if (child != NONE && child > node)
+            stack.push_back(child);
+    }
+    return sum;
+}
+
+/* Generate the plant with its growth cache, and again with every node
+   evaluated afresh, returning how many cones differ */
+static int growthTest(plant &p, int &cones)
+{
+    plant fresh = p;
+    fresh.node_shared.assign(fresh.node_shared.size(), true);
+    std::vector<cone> want, got;
+    generate(fresh, want);
+    generate(p, got);
+    cones = got.size();
+    if (want.size() != got.size())
+        return cones;
+    int wrong = 0;
+    for (int i=0; i<cones; i++)
+    {
+        float diff = fabsf(got[i].height - want[i].height);
+        for (int k=0; k<3; k++)
+            diff = fmaxf(diff, fabsf(got[i].color[k] - want[i].color[k]));
+        if (diff > 1e-4f*fmaxf(1, want[i].height))
+            wrong++;
+    }
+    return wrong;
+}
+
+/* Ray from a random point around the plant through a random cone, so most
+   rays hit something and many pass other cones on the way */
+static void aimRay(const snapshot &snap, const float center[3], float reach,
+                   std::default_random_engine &rng, float origin[3],
+                   float dir[3])
+{
+    std::uniform_real_distribution<float> unit(-1, 1);
+    std::uniform_int_distribution<int> pick(0, snap.cones.size()-1);
+    const cone &c = snap.cones[pick(rng)];
+    float len = 0;
+    while (len < 1e-3f || len > 1)
+    {
+        for (int i=0; i<3; i++)
+            dir[i] = unit(rng);
+        len = sqrtf(dir[0]*dir[0] + dir[1]*dir[1] + dir[2]*dir[2]);
+    }
+    float target[3];
+    for (int i=0; i<3; i++)
+    {
+        origin[i] = center[i] + 2*reach*dir[i]/len;
+        target[i] = c.mat[12+i] + 0.5f*c.height*c.mat[8+i];
+        dir[i] = target[i] - origin[i];
+    }
+    len = sqrtf(dir[0]*dir[0] + dir[1]*dir[1] + dir[2]*dir[2]);
+    for (int i=0; i<3; i++)
+        dir[i] /= len;
+}
+
+/* Time picks through the hierarchy against testing every cone, returning
+   how many picks the two disagree on */
+static int pickTest(const snapshot &snap, double &build, double &fast,
+                    double &slow)
+{
+    bvh b;
+    bvhInit(b);
+    double start = now();
+    bvhUpdate(b, snap);
+    build = now() - start;
+
+    /* Same cones with no tree, so every one is tested */
+    bvh all = b;
+    all.extra.insert(all.extra.end(), all.prims.begin(), all.prims.end());
+    all.prims.clear();
+    all.nodes.clear();
+
+    float lo[3], hi[3], center[3], reach = 0;
+    for (int i=0; i<3; i++)
+    {
+        lo[i] = b.nodes[0].lo[i];
+        hi[i] = b.nodes[0].hi[i];
+        center[i] = (lo[i] + hi[i])/2;
+        reach = fmaxf(reach, hi[i] - lo[i]);
+    }
+
+    std::default_random_engine rng(1);
+    int wrong = 0;
+    fast = slow = 0;
+    for (int i=0; i<BENCH_PICKS; i++)
+    {
+        float origin[3], dir[3];
+        pickHit hit, want;
+        aimRay(snap, center, reach, rng, origin, dir);
+        start = now();
+        bvhPick(b, snap, origin, dir, hit);
+        fast += now() - start;
+        start = now();
+        bvhPick(all, snap, origin, dir, want);
+        slow += now() - start;
+
+        /* Cones of a node meet end to end, so allow ties at a joint */
+        if ((hit.node == NONE) != (want.node == NONE) ||
+            (hit.node != NONE && fabsf(hit.t - want.t) > 1e-4f*want.t))
+            wrong++;
+    }
+    fast /= BENCH_PICKS;
+    slow /= BENCH_PICKS;
+    return wrong;
+}
+
+int main(int argc, char** argv)
+{
+    plant p;
+    coneSink skip = {NULL, NULL};
+    initPlant(p);
+    seedPlant(p, 1);
+
+    /* Grow plant in small steps until it is big enough */
+    while (p.nextFree < BENCH_NODES && p.time_cur < 100)
+    {
+        int before = p.nextFree;
+        p.time_cur += 0.05;
+        generate(p, skip);
+        if (p.nextFree + 2*(p.nextFree - before) >= STATE_SIZE)
+            break;
+    }
+    int nodes = p.nextFree + 1;
+
+    /* Many short runs, as a mean mostly measures whatever else is running.
+       The fastest is the one to compare, the median shows how noisy. */
+    double sum = 0, walk, walk_median, gen, gen_median;
+    std::vector<double> times;
+    for (int i=0; i<BENCH_WALKS; i++)
+    {
+        double start = now();
+        sum += walkTree(p);
+        times.push_back(now() - start);
+    }
+    spread(times, walk, walk_median);
+    times.clear();
+    for (int i=0; i<BENCH_RUNS; i++)
+    {
+        double start = now();
+        generate(p, skip);
+        times.push_back(now() - start);
+    }
+    spread(times, gen, gen_median);
+
+    /* Per node growth caches kept alongside the tree, see plant */
+    double cache = 2/8.0 + 6*sizeof(float);
+    printf("layout %d: %d nodes, %d bytes/node (%.1f with growth caches), "
+           "walk %.2f ns/node (median %.2f), generate %.1f ns/node "
+           "(median %.1f)%s\n", STATE_ENCODING, nodes,
+           (int)sizeof(stored_state), sizeof(stored_state) + cache,
+           walk*1e9/nodes, walk_median*1e9/nodes, gen*1e9/nodes,
+           gen_median*1e9/nodes, sum == 0 ? " (empty)" : "");
+
+    int cones, stale = growthTest(p, cones);
+    printf("layout %d: growth cache, %d of %d cones differ\n",
+           STATE_ENCODING, stale, cones);
+
+    /* Snapshot of the plant as the simulation would publish it */
+    snapshot snap;
+    generate(p, snap.cones);
+    snap.time_cur = p.time_cur;
+    snap.wall = 0;
+    snap.epoch = 0;
+    indexSnapshot(snap, p.nextFree+1);
+
+    double build, fast, slow;
+    int wrong = pickTest(snap, build, fast, slow);
+    printf("layout %d: %d cones, bvh build %.1f ms, pick %.2f us, "
+           "every cone %.1f us, %d of %d picks differ\n", STATE_ENCODING,
+           (int)snap.cones.size(), build*1e3, fast*1e6, slow*1e6, wrong,
+           BENCH_PICKS);
+    return wrong || stale ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+/******************************************************************************
+ *    File : compact.h
+ * Descrip : Storage layouts for state tree nodes, chosen by STATE_ENCODING.
+ *           Layout 0 stores state as is. Layouts 1 and 2 quantize size to a
+ *           half float, angles and time to 16 bit fixed point, and pack the
+ *           rule into the low bits of azimuth; layout 1 has 16 bit links
+ *           (12 bytes) and layout 2 has 32 bit links (16 bytes). Links are
+ *           stored plus one, so NONE is 0 and decoding needs no branch.
+ *****************************************************************************/
+
+#pragma once
+
+#include "params.h"
+#include <math.h>                       /* Need math functions */
+#include <stdint.h>
+#include <string.h>                     /* String operations */
+
+/* Constants */
+#define DEG_SCALE 32                    /* deg steps per degree, |deg| < 1024 */
+#define AZIM_STEPS 16384                /* azimuth steps per turn */
+#define TIME_SCALE 4096                 /* mytime steps per unit, |t| < 8 */
+
+#if STATE_ENCODING == 0
+typedef state stored_state;
+#else
+typedef struct stored_state {
+    uint16_t size;                      /* Half float */
+    int16_t deg;                        /* deg*DEG_SCALE */
+    uint16_t azim_rule;                 /* azimuth in top 14 bits, rule low 2 */
+    int16_t mytime;                     /* mytime*TIME_SCALE */
+#if STATE_ENCODING == 1
+    uint16_t child, sibling;            /* Node plus one, 0 is NONE */
+#else
+    uint32_t child, sibling;            /* Node plus one, 0 is NONE */
+#endif
+} stored_state;
+#endif
+
+#if STATE_ENCODING == 1
+static_assert(STATE_SIZE < 0xffff, "STATE_SIZE needs STATE_ENCODING 2");
+#endif
+
+/* Float to half float, tiny values go to zero and huge ones to the max */
+static inline uint16_t toHalf(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    int32_t e = (int32_t)((x >> 23) & 0xff) - 127 + 15;
+    if (e <= 0)
+        return sign;
+    if (e >= 31)
+        return sign | 0x7bff;
+    uint32_t h = (e << 10) + (((x & 0x7fffff) + 0x1000) >> 13);
+    return sign | (h > 0x7bff ? 0x7bff : h);
+}
+
+/* Float with the given bits */
+static inline float asFloat(uint32_t x)
+{
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+/* Half float to float. toHalf makes no denormals, infinities or NaNs, so
+   the exponent and mantissa moved over are a float 2^112 too small, and a
+   multiply rebiases it, zero included. */
+static inline float fromHalf(uint16_t h)
+{
+    return asFloat(((uint32_t)(h & 0x8000) << 16) |
+                   ((uint32_t)(h & 0x7fff) << 13))*0x1p112f;
+}
+
+/* Round to nearest step and clamp to 16 bits */
+static inline int16_t toFixed(float f, float scale)
+{
+    float v = f*scale + (f < 0 ? -0.5f : 0.5f);
+    return (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+/* Fixed point to float, for a power of two scale. The steps, offset to be
+   unsigned, go in the mantissa of a float whose last bit is worth one step,
+   so taking off that float and the offset leaves the value exactly, without
+   converting an integer. */
+static inline float fromFixed(int16_t v, float scale)
+{
+    const float base = 8388608.0f/scale;
+    uint32_t bits;
+    memcpy(&bits, &base, sizeof(bits));
+    return asFloat(bits ^ 0x8000 ^ (uint16_t)v) - (base + 32768.0f/scale);
+}
+
+/* Links of a node, NONE if there is none */
+static inline int getChild(const stored_state &s)
+{
+#if STATE_ENCODING == 0
+    return s.child;
+#else
+    return (int)s.child - 1;
+#endif
+}
+
+static inline int getSibling(const stored_state &s)
+{
+#if STATE_ENCODING == 0
+    return s.sibling;
+#else
+    return (int)s.sibling - 1;
+#endif
+}
+
+static inline void setChild(stored_state &s, int node)
+{
+#if STATE_ENCODING == 0
+    s.child = node;
+#else
+    s.child = node + 1;
+#endif
+}
+
+static inline void setSibling(stored_state &s, int node)
+{
+#if STATE_ENCODING == 0
+    s.sibling = node;
+#else
+    s.sibling = node + 1;
+#endif
+}
+
+/* Store node */
+static inline void packState(stored_state &s, const state &u)
+{
+#if STATE_ENCODING == 0
+    s = u;
+#else
+    float turns = u.azimuth/360;
+    turns -= floorf(turns);
+    s.size = toHalf(u.size);
+    s.deg = toFixed(u.deg, DEG_SCALE);
+    s.azim_rule = ((uint16_t)(turns*AZIM_STEPS + 0.5f) << 2) | (u.rule & 3);
+    s.mytime = toFixed(u.mytime, TIME_SCALE);
+    setChild(s, u.child);
+    setSibling(s, u.sibling);
+#endif
+}
+
+/* Retrieve node */
+static inline void unpackState(const stored_state &s, state &u)
+{
+#if STATE_ENCODING == 0
+    u = s;
+#else
+    u.size = fromHalf(s.size);
+    u.deg = fromFixed(s.deg, DEG_SCALE);
+    u.azimuth = (asFloat(0x4b000000 | (s.azim_rule >> 2)) - 8388608.0f)*
+                (360.0f/AZIM_STEPS);    /* 2^23 plus steps, less 2^23 */
+    u.mytime = fromFixed(s.mytime, TIME_SCALE);
+    u.rule = s.azim_rule & 3;
+    u.child = getChild(s);
+    u.sibling = getSibling(s);
+#endif
+}
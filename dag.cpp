@@ -0,0 +1,207 @@
+/******************************************************************************
+ *    File : dag.cpp
+ * Descrip : Implementation file for sharing identical subtrees. The state
+ *           tree is hash-consed so that identical subtrees are stored once,
+ *           making it a DAG. Geometry of each subtree reached at a given
+ *           time is generated once a frame as a part, and placed wherever
+ *           else it occurs by reference with a transform. Only generating
+ *           is shared: emitParts still expands every reference into full
+ *           cones for the sink, so each frame costs time linear in the cones
+ *           drawn, and a part is never drawn as an instance.
+ *****************************************************************************/
+
+/* Include files */
+#include "dag.h"
+#include "matrix.h"
+#include <algorithm>
+#include <string.h>                     /* String operations */
+
+/* Types */
+typedef struct nodeKey {
+    float size, deg, azimuth, mytime;
+    int rule;
+    int child, sibling;                 /* Classes of linked subtrees */
+    bool operator==(const nodeKey &k) const
+    {
+        return memcmp(this, &k, sizeof(k)) == 0;
+    }
+} nodeKey;
+
+typedef struct nodeHash {
+    size_t operator()(const nodeKey &k) const
+    {
+        return hashBytes(&k, sizeof(k));
+    }
+    static size_t hashBytes(const void *data, int n);
+} nodeHash;
+
+/* FNV-1a hash of some bytes */
+size_t nodeHash::hashBytes(const void *data, int n)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t h = 14695981039346656037ULL;
+    for (int i=0; i<n; i++)
+        h = (h ^ bytes[i]) * 1099511628211ULL;
+    return h;
+}
+
+size_t partHash::operator()(const partKey &k) const
+{
+    size_t h = nodeHash::hashBytes(&k.node, sizeof(k.node));
+    h = h*31 + nodeHash::hashBytes(&k.mytime, sizeof(k.mytime));
+    return h*31 + nodeHash::hashBytes(&k.size_bot, sizeof(k.size_bot)) +
+           k.level;
+}
+
+/* Replace every set of identical subtrees in the state tree with one copy.
+   Links always point to newer nodes, so walking nodes from newest to oldest
+   classifies children before their parents. Nodes are then renumbered by
+   height so that links still point forward. moved is set to the new number
+   of each old node. False if nothing was shared and nodes kept their
+   numbers. */
+bool dedupStates(plant &p, std::vector<int> &moved)
+{
+    int n = p.nextFree + 1;
+    std::vector<int> cls(n);            /* Class of each node */
+    std::vector<int> rep;               /* A node of each class */
+    std::vector<int> height;            /* Height of each class */
+    std::unordered_map<nodeKey, int, nodeHash> classes;
+
+    for (int i=n-1; i>=0; i--)
+    {
+        state s;
+        unpackState(p.states[i], s);
+        if ((s.child != NONE && s.child <= i) ||
+            (s.sibling != NONE && s.sibling <= i))
+            return false;               /* Not a forward tree, leave as is */
+
+        nodeKey k;
+        memset(&k, 0, sizeof(k));
+        k.size = s.size + 0.0f;         /* Adding zero turns -0 into 0 */
+        k.deg = s.deg + 0.0f;
+        k.azimuth = s.azimuth + 0.0f;
+        k.mytime = s.mytime + 0.0f;
+        k.rule = s.rule;
+        k.child = s.child == NONE ? NONE : cls[s.child];
+        k.sibling = s.sibling == NONE ? NONE : cls[s.sibling];
+
+        std::pair<std::unordered_map<nodeKey, int, nodeHash>::iterator, bool>
+            found = classes.insert(std::make_pair(k, (int)rep.size()));
+        cls[i] = found.first->second;
+        if (found.second)
+        {
+            rep.push_back(i);
+            height.push_back(1 + std::max(
+                k.child == NONE ? 0 : height[k.child],
+                k.sibling == NONE ? 0 : height[k.sibling]));
+        }
+    }
+    if ((int)rep.size() == n)
+        return false;
+
+    /* Highest first puts the root at 0 and parents before children */
+    std::vector<int> order(rep.size());
+    std::vector<int> index(rep.size());
+    for (int c=0; c<(int)order.size(); c++)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int a, int b) { return height[a] > height[b]; });
+    for (int i=0; i<(int)order.size(); i++)
+        index[order[i]] = i;
+
+    std::vector<stored_state> states(order.size());
+    for (int i=0; i<(int)order.size(); i++)
+    {
+        state s;
+        unpackState(p.states[rep[order[i]]], s);
+        if (s.child != NONE)
+            s.child = index[cls[s.child]];
+        if (s.sibling != NONE)
+            s.sibling = index[cls[s.sibling]];
+        packState(states[i], s);
+    }
+    std::copy(states.begin(), states.end(), p.states.begin());
+
+    /* A shared node keeps the growth of one of the nodes it replaces */
+    std::vector<float> time(p.node_time.begin(), p.node_time.begin()+n);
+    std::vector<float> factor(p.node_factor.begin(), p.node_factor.begin()+n);
+    moved.resize(n);
+    for (int i=0; i<n; i++)
+    {
+        moved[i] = index[cls[i]];
+        p.node_time[moved[i]] = time[i];
+        p.node_factor[moved[i]] = factor[i];
+    }
+    p.nextFree = order.size() - 1;
+    p.root = moved[p.root];
+    p.renumbers++;
+    return true;
+}
+
+/* Forget parts of previous frame */
+void clearParts(plant &p)
+{
+    p.nparts = 0;
+    p.part_index.clear();
+}
+
+/* Part for key, made empty if it is new this frame */
+int findPart(plant &p, const partKey &key, bool &made)
+{
+    std::pair<std::unordered_map<partKey, int, partHash>::iterator, bool>
+        found = p.part_index.insert(std::make_pair(key, p.nparts));
+    made = found.second;
+    if (!made)
+        return found.first->second;
+    if (p.nparts == (int)p.parts.size())
+        p.parts.push_back(part());
+    p.parts[p.nparts].cones.clear();
+    p.parts[p.nparts].refs.clear();
+    return p.nparts++;
+}
+
+/* Place part inside owner */
+void addPartRef(plant &p, int owner, int part, const float mat[16])
+{
+    p.parts[owner].refs.push_back(partRef());
+    partRef &r = p.parts[owner].refs.back();
+    r.part = part;
+    memcpy(r.mat, mat, sizeof(r.mat));
+}
+
+/* Pass cones of part 0 and everything placed in it to sink, with part 0
+   placed at mat */
+void emitParts(plant &p, const float mat[16], coneSink &sink)
+{
+    std::vector<partRef> stack(1);
+    std::vector<cone> chunk;
+    chunk.reserve(GEOM_CHUNK);
+    stack[0].part = 0;
+    memcpy(stack[0].mat, mat, sizeof(stack[0].mat));
+
+    while (!stack.empty())
+    {
+        partRef at = stack.back();
+        stack.pop_back();
+        const part &pt = p.parts[at.part];
+        for (int i=0; i<(int)pt.cones.size(); i++)
+        {
+            chunk.push_back(pt.cones[i]);
+            matMultiply(chunk.back().mat, at.mat, pt.cones[i].mat);
+            if ((int)chunk.size() == GEOM_CHUNK)
+            {
+                if (sink.emit)
+                    sink.emit(&chunk[0], chunk.size(), sink.data);
+                chunk.clear();
+            }
+        }
+        for (int i=0; i<(int)pt.refs.size(); i++)
+        {
+            stack.push_back(partRef());
+            stack.back().part = pt.refs[i].part;
+            matMultiply(stack.back().mat, at.mat, pt.refs[i].mat);
+        }
+    }
+    if (!chunk.empty() && sink.emit)
+        sink.emit(&chunk[0], chunk.size(), sink.data);
+}
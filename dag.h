@@ -0,0 +1,16 @@
+/******************************************************************************
+ *    File : dag.h
+ * Descrip : Header file for sharing identical subtrees of a plant, both in
+ *           the state tree and in generated geometry
+ *****************************************************************************/
+
+#pragma once
+
+#include "grow.h"
+
+/* Procedure prototypes */
+bool dedupStates(plant &p, std::vector<int> &moved);
+void clearParts(plant &p);
+int findPart(plant &p, const partKey &key, bool &made);
+void addPartRef(plant &p, int owner, int part, const float mat[16]);
+void emitParts(plant &p, const float mat[16], coneSink &sink);
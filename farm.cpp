@@ -0,0 +1,506 @@
+/******************************************************************************
+ *    File : farm.cpp
+ * Descrip : Implementation file for the render farm. A job directory holds
+ *           the job description and a queue of shards, each a range of
+ *           frames. Workers claim a shard by renaming it from .todo to
+ *           .run.<pid>, render its frames with the software renderer and
+ *           rename it to .done. A worker that can't write a frame puts its
+ *           shard back and stops. After each shard the worker saves the
+ *           plant, so a worker taking a later shard grows on from there
+ *           instead of from the first frame. The driver requeues shards of
+ *           workers that died, and moves finished frames to the output in
+ *           order. Only turntable shots are rendered, there are no camera
+ *           paths.
+ *
+ *           Usage: plant-grow --farm <dir> [options]
+ *                  plant-grow --worker <dir>
+ *           Options: --state <file> --seed <n> --time <from> <to>
+ *                    --frames <n> --turn <degrees> --size <w> <h>
+ *                    --shard <frames> --workers <n> --out <dir>
+ *           Running --farm on an existing job directory resumes the job.
+ *****************************************************************************/
+
+/* Include files */
+#include "farm.h"
+#include "grow.h"
+#include "raster.h"
+#include "matrix.h"
+#include "bitmap.h"
+#include <dirent.h>                     /* For reading queue directory */
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>                      /* For file operations */
+#include <stdlib.h>
+#include <string.h>                     /* String operations */
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/* Constants */
+#define FARM_POLL 100000                /* Driver poll interval in usec */
+#define FARM_RETRIES 3                  /* Respawns allowed per worker */
+#define FARM_SEEDED (!STOCASTIC_PLANT && !SURROUNDINGS) /* Saved plant
+                                           grows on the same as a serial
+                                           render */
+
+/* Types */
+typedef struct farmjob {
+    char state[256];                    /* State file, empty for new plant */
+    char out[256];                      /* Directory frames are collected in */
+    unsigned int seed;                  /* Seed for stocastic plant */
+    float time_from, time_to;           /* Plant time of first, last frame */
+    int frames;                         /* Number of frames */
+    float turn;                         /* Turntable degrees over the job */
+    int width, height;                  /* Frame size */
+    int shard;                          /* Frames per shard */
+} farmjob;
+
+/* Write job description */
+static bool writeJob(const std::string &dir, const farmjob &job)
+{
+    FILE *out = fopen((dir + "/job").c_str(), "w");
+    if (out == NULL)
+        return false;
+    fprintf(out, "state=%s\nout=%s\nseed=%u\ntime_from=%.9g\ntime_to=%.9g\n"
+            "frames=%d\nturn=%.9g\nwidth=%d\nheight=%d\nshard=%d\n",
+            job.state, job.out, job.seed, job.time_from, job.time_to, job.frames,
+            job.turn, job.width, job.height, job.shard);
+    fclose(out);
+    return true;
+}
+
+/* Read job description */
+static bool readJob(const std::string &dir, farmjob &job)
+{
+    FILE *in = fopen((dir + "/job").c_str(), "r");
+    char line[512];
+    if (in == NULL)
+        return false;
+    memset(&job, 0, sizeof(job));
+    while (fgets(line, sizeof(line), in))
+    {
+        line[strcspn(line, "\n")] = 0;
+        char *value = strchr(line, '=');
+        if (value == NULL)
+            continue;
+        *value++ = 0;
+        if (strcmp(line, "state") == 0)
+            snprintf(job.state, sizeof(job.state), "%s", value);
+        else if (strcmp(line, "out") == 0)
+            snprintf(job.out, sizeof(job.out), "%s", value);
+        else if (strcmp(line, "seed") == 0)
+            job.seed = strtoul(value, NULL, 10);
+        else if (strcmp(line, "time_from") == 0)
+            job.time_from = atof(value);
+        else if (strcmp(line, "time_to") == 0)
+            job.time_to = atof(value);
+        else if (strcmp(line, "frames") == 0)
+            job.frames = atoi(value);
+        else if (strcmp(line, "turn") == 0)
+            job.turn = atof(value);
+        else if (strcmp(line, "width") == 0)
+            job.width = atoi(value);
+        else if (strcmp(line, "height") == 0)
+            job.height = atoi(value);
+        else if (strcmp(line, "shard") == 0)
+            job.shard = atoi(value);
+    }
+    fclose(in);
+    return job.frames > 0 && job.width > 0 && job.height > 0 && job.shard > 0;
+}
+
+/* Plant time of a frame */
+static float frameTime(const farmjob &job, int frame)
+{
+    if (job.frames < 2)
+        return job.time_from;
+    return job.time_from + frame*(job.time_to-job.time_from)/(job.frames-1);
+}
+
+/* Name of a file in the queue directory */
+static std::string queueFile(const std::string &dir, int shard,
+                             const char *suffix)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/queue/%05d%s", shard, suffix);
+    return dir + name;
+}
+
+/* Name of a rendered frame */
+static std::string frameFile(const std::string &dir, int frame)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/frame%05d.bmp", frame);
+    return dir + name;
+}
+
+/* Name of the plant saved after a frame */
+static std::string seedFile(const std::string &dir, int frame)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/seeds/%05d.state", frame);
+    return dir + name;
+}
+
+/* Latest frame before shard that the plant was saved after, -1 if none */
+static int findSeed(const std::string &dir, const farmjob &job, int shard)
+{
+    for (int s=shard-1; s>=0; s--)
+        if (access(seedFile(dir, (s+1)*job.shard-1).c_str(), F_OK) == 0)
+            return (s+1)*job.shard - 1;
+    return -1;
+}
+
+/* List queue entries, sorted by shard */
+static std::vector<std::string> listQueue(const std::string &dir)
+{
+    std::vector<std::string> names;
+    DIR *d = opendir((dir + "/queue").c_str());
+    if (d == NULL)
+        return names;
+    while (struct dirent *e = readdir(d))
+        if (e->d_name[0] != '.')
+            names.push_back(e->d_name);
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+/* Move shards claimed by pid, or by any dead process if pid is 0, back to
+   the queue. Returns number of shards requeued. */
+static int requeue(const std::string &dir, pid_t pid)
+{
+    std::vector<std::string> names = listQueue(dir);
+    int count = 0;
+    for (int i=0; i<(int)names.size(); i++)
+    {
+        int shard, owner;
+        if (sscanf(names[i].c_str(), "%d.run.%d", &shard, &owner) != 2)
+            continue;
+        if (pid ? owner != pid : kill(owner, 0) == 0 || errno != ESRCH)
+            continue;
+        if (rename((dir + "/queue/" + names[i]).c_str(),
+                   queueFile(dir, shard, ".todo").c_str()) == 0)
+            count++;
+    }
+    return count;
+}
+
+/* Count queue entries ending with suffix */
+static int countQueue(const std::string &dir, const char *suffix)
+{
+    std::vector<std::string> names = listQueue(dir);
+    int count = 0;
+    for (int i=0; i<(int)names.size(); i++)
+        if (names[i].find(suffix) != std::string::npos)
+            count++;
+    return count;
+}
+
+/* Claim next shard in queue, returns shard number or -1 if none left */
+static int claimShard(const std::string &dir)
+{
+    std::vector<std::string> names = listQueue(dir);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".run.%d", (int)getpid());
+    for (int i=0; i<(int)names.size(); i++)
+    {
+        int shard;
+        char todo[32];
+        if (sscanf(names[i].c_str(), "%d%31s", &shard, todo) != 2 ||
+            strcmp(todo, ".todo") != 0)
+            continue;
+        /* Rename is atomic, so only one worker gets each shard */
+        if (rename(queueFile(dir, shard, ".todo").c_str(),
+                   queueFile(dir, shard, suffix).c_str()) == 0)
+            return shard;
+    }
+    return -1;
+}
+
+/* Start plant and view for a job, false if its state file can't be read */
+static bool startPlant(const farmjob &job, plant &p, float view[16])
+{
+    initPlant(p);
+    seedPlant(p, job.seed);
+    matIdentity(view);
+    matTranslate(view, 0.0, 0.0, -15.0);
+    return !job.state[0] || load_state(p, job.state, view);
+}
+
+/* Render frames of claimed shards until queue is empty */
+int workerMain(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        fprintf(stderr, "usage: plant-grow --worker <dir>\n");
+        return 2;
+    }
+    std::string dir = argv[0];
+    farmjob job;
+    if (!readJob(dir, job))
+    {
+        fprintf(stderr, "%s: can't read job\n", dir.c_str());
+        return 1;
+    }
+
+    plant p;
+    float start[16], view[16];
+    canvas c;
+    coneSink skip = {NULL, NULL};
+    coneSink draw = {canvasDraw, &c};
+    std::vector<unsigned char> rgb(3*job.width*job.height);
+    frustum f = windowFrustum(job.width, job.height);
+    int rolled = -1;                    /* Last frame plant was grown to */
+    char running[32];
+    snprintf(running, sizeof(running), ".run.%d", (int)getpid());
+
+    int shard;
+    while ((shard = claimShard(dir)) >= 0)
+    {
+        int first = shard*job.shard;
+        int last = std::min(first + job.shard, job.frames);
+
+        /* Grow through every frame like a serial render would, from the
+           latest plant saved before the shard if that is nearer. Nodes
+           of stocastic plants depend on the random numbers drawn before
+           them, and the surroundings on every frame before, which are not
+           saved, so those grow from the start. */
+        int seed = FARM_SEEDED ? findSeed(dir, job, shard) : -1;
+        if (rolled < 0 || rolled >= first || seed > rolled)
+        {
+            float at[16];
+            if (!startPlant(job, p, start))
+            {
+                fprintf(stderr, "%s: can't read state\n", job.state);
+                requeue(dir, getpid());
+                return 1;
+            }
+            rolled = -1;
+            if (seed >= 0 && load_state(p, seedFile(dir, seed).c_str(), at))
+                rolled = seed;
+        }
+        for (int frame=rolled+1; frame<last; frame++)
+        {
+            p.time_cur = frameTime(job, frame);
+            rolled = frame;
+            std::string name = frameFile(dir + "/frames", frame);
+            if (frame < first || access(name.c_str(), F_OK) == 0 ||
+                access(frameFile(job.out, frame).c_str(), F_OK) == 0)
+            {
+                generate(p, skip);
+                continue;
+            }
+
+            /* Turn camera about the trunk */
+            float angle = job.frames > 1 ? frame*job.turn/job.frames : 0;
+            memcpy(view, start, sizeof(view));
+            matTranslate(view, STARTX, 0, -STARTY);
+            matRotateY(view, angle);
+            matTranslate(view, -STARTX, 0, STARTY);
+
+            /* Cones are drawn as they are generated. Write to a temporary
+               name first so frames are never partial. */
+            canvasBegin(c, view, f, job.width, job.height, &rgb[0]);
+            generate(p, draw);
+            std::string tmp = name + running;
+            if (!writeBMP((char *)tmp.c_str(), job.width, job.height, &rgb[0]) ||
+                rename(tmp.c_str(), name.c_str()) != 0)
+            {
+                fprintf(stderr, "%s: can't write frame\n", name.c_str());
+                remove(tmp.c_str());
+                requeue(dir, getpid());
+                return 1;
+            }
+        }
+
+        /* A plant that can't be saved only costs later shards time */
+#if FARM_SEEDED
+        std::string seed_name = seedFile(dir, last-1);
+        std::string tmp = seed_name + running;
+        if (!save_state(p, tmp.c_str(), start) ||
+            rename(tmp.c_str(), seed_name.c_str()) != 0)
+            remove(tmp.c_str());
+#endif
+        if (rename(queueFile(dir, shard, running).c_str(),
+                   queueFile(dir, shard, ".done").c_str()) != 0)
+        {
+            fprintf(stderr, "%s: can't finish shard %d\n", dir.c_str(), shard);
+            requeue(dir, getpid());
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Start a worker process */
+static pid_t spawnWorker(const std::string &dir)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        char *args[] = {(char *)dir.c_str(), NULL};
+        _exit(workerMain(1, args));
+    }
+    return pid;
+}
+
+/* Move frames that are done to output in order, returns next frame needed */
+static int collect(const std::string &dir, const std::string &out, int next,
+                   int frames)
+{
+    for (; next<frames; next++)
+    {
+        std::string name = frameFile(dir + "/frames", next);
+        if (access(name.c_str(), F_OK) != 0)
+            break;
+        if (rename(name.c_str(), frameFile(out, next).c_str()) != 0)
+        {
+            fprintf(stderr, "can't move %s to %s\n", name.c_str(), out.c_str());
+            break;
+        }
+    }
+    return next;
+}
+
+/* Split job into shards and run workers over them */
+int farmMain(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        fprintf(stderr, "usage: plant-grow --farm <dir> [options]\n");
+        return 2;
+    }
+    std::string dir = argv[0];
+    int workers = sysconf(_SC_NPROCESSORS_ONLN);
+    farmjob job;
+    bool resume = readJob(dir, job);
+    if (!resume)
+    {
+        memset(&job, 0, sizeof(job));
+        strcpy(job.out, ".");
+        job.seed = time(0);
+        job.time_from = 1;
+        job.time_to = 11;
+        job.frames = 300;
+        job.width = 500;
+        job.height = 500;
+        job.shard = 10;
+    }
+
+    /* Options set up the job, but can't change a job that is resuming */
+    for (int i=1; i<argc; i++)
+    {
+        bool more = i+1 < argc;
+        if (strcmp(argv[i], "--workers") == 0 && more)
+            workers = atoi(argv[++i]);
+        else if (resume)
+        {
+            fprintf(stderr, "%s: resuming, ignoring %s\n", dir.c_str(),
+                    argv[i]);
+        }
+        else if (strcmp(argv[i], "--state") == 0 && more)
+            snprintf(job.state, sizeof(job.state), "%s", argv[++i]);
+        else if (strcmp(argv[i], "--out") == 0 && more)
+            snprintf(job.out, sizeof(job.out), "%s", argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && more)
+            job.seed = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--time") == 0 && i+2 < argc)
+        {
+            job.time_from = atof(argv[++i]);
+            job.time_to = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && more)
+            job.frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--turn") == 0 && more)
+            job.turn = atof(argv[++i]);
+        else if (strcmp(argv[i], "--size") == 0 && i+2 < argc)
+        {
+            job.width = atoi(argv[++i]);
+            job.height = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--shard") == 0 && more)
+            job.shard = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (job.frames < 1 || job.width < 1 || job.height < 1 || job.shard < 1)
+    {
+        fprintf(stderr, "bad job parameters\n");
+        return 2;
+    }
+
+    /* Set up job directory and queue */
+    int shards = (job.frames + job.shard - 1)/job.shard;
+    if (!resume)
+    {
+        mkdir(dir.c_str(), 0777);
+        mkdir((dir + "/queue").c_str(), 0777);
+        mkdir((dir + "/frames").c_str(), 0777);
+        mkdir((dir + "/seeds").c_str(), 0777);
+        if (!writeJob(dir, job))
+        {
+            fprintf(stderr, "%s: can't write job\n", dir.c_str());
+            return 1;
+        }
+        for (int i=0; i<shards; i++)
+        {
+            FILE *todo = fopen(queueFile(dir, i, ".todo").c_str(), "w");
+            if (todo == NULL)
+            {
+                fprintf(stderr, "%s: can't write queue\n", dir.c_str());
+                return 1;
+            }
+            fclose(todo);
+        }
+    }
+    else if (int n = requeue(dir, 0))
+        fprintf(stderr, "%s: requeued %d unfinished shards\n", dir.c_str(), n);
+    std::string out = job.out;
+    mkdir(out.c_str(), 0777);
+
+    /* Find first frame not yet collected */
+    int next = 0;
+    while (next < job.frames && access(frameFile(out, next).c_str(), F_OK) == 0)
+        next++;
+
+    std::vector<pid_t> pids;
+    for (int i=0; i<std::min(workers, shards); i++)
+        pids.push_back(spawnWorker(dir));
+    int respawns = FARM_RETRIES*workers;
+
+    while (!pids.empty())
+    {
+        int status;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid > 0)
+        {
+            pids.erase(std::remove(pids.begin(), pids.end(), pid), pids.end());
+            bool crashed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            if (crashed && requeue(dir, pid) > 0 && respawns-- > 0)
+            {
+                fprintf(stderr, "worker %d died, resuming its shard\n", pid);
+                pids.push_back(spawnWorker(dir));
+            }
+        }
+        next = collect(dir, out, next, job.frames);
+        if (pid <= 0)
+            usleep(FARM_POLL);
+    }
+    next = collect(dir, out, next, job.frames);
+
+    if (next < job.frames || countQueue(dir, ".done") < shards)
+    {
+        fprintf(stderr, "%s: %d of %d frames done, run again to resume\n",
+                dir.c_str(), next, job.frames);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,11 @@
+/******************************************************************************
+ *    File : farm.h
+ * Descrip : Header file for rendering frames of a growth movie across
+ *           several local worker processes
+ *****************************************************************************/
+
+#pragma once
+
+/* Procedure prototypes */
+int farmMain(int argc, char** argv);
+int workerMain(int argc, char** argv);
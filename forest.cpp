@@ -0,0 +1,436 @@
+/******************************************************************************
+ *    File : forest.cpp
+ * Descrip : Implementation file for paged forests. A forest directory holds
+ *           a description and one file per tile with the grown state trees
+ *           of the plants on it. Tiles around the camera are mapped in with
+ *           mmap, copy on write so the file is never changed, and the
+ *           plants are generated straight from the mapped states. Tiles
+ *           the camera is heading for are mapped ahead of time and the
+ *           kernel asked to read them in the background. When mapped tiles
+ *           go over the memory budget, the least recently needed are
+ *           dropped.
+ *
+ *           Usage: plant-grow --make-forest <dir> [options]
+ *                  plant-grow --forest <dir> [budget in MB]
+ *           Options: --tiles <x> <z> --tile-size <width> --per-tile <n>
+ *                    --seed <n> --time <from> <to>
+ *****************************************************************************/
+
+/* Include files */
+#include "forest.h"
+#include "matrix.h"
+#include <fcntl.h>
+#include <math.h>                       /* Need math functions */
+#include <stdint.h>
+#include <stdio.h>                      /* For file operations */
+#include <stdlib.h>
+#include <string.h>                     /* String operations */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <random>
+
+/* Constants */
+#define FOREST_MAGIC "PLNTTILE"         /* Start of every tile file */
+#define FOREST_STEP 0.05                /* Time step growing a plant */
+
+/* Types */
+typedef struct tileHeader {
+    char magic[8];                      /* FOREST_MAGIC */
+    int encoding;                       /* STATE_ENCODING of states */
+    int state_bytes;                    /* Size of a stored state */
+    int plants;                         /* Plants on tile */
+    int pad;
+} tileHeader;
+
+typedef struct tilePlant {
+    float x, z;                         /* Where plant stands in world */
+    float time_cur;                     /* Time plant was grown to */
+    int nextFree;                       /* Last state used */
+    int root;                           /* Root of state tree */
+    int pad;
+    int64_t offset;                     /* Byte offset of states in file */
+} tilePlant;
+
+typedef struct placedSink {
+    coneSink *out;                      /* Where placed cones go */
+    const float *place;                 /* Placement of plant */
+    cone cones[GEOM_CHUNK];             /* Placed cones */
+} placedSink;
+
+/* Name of file of a tile */
+static std::string tileFile(const std::string &dir, int x, int z)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/tile_%03d_%03d", x, z);
+    return dir + name;
+}
+
+/* Position of camera in world from world to eye transform */
+static void cameraPosition(const float view[16], float pos[3])
+{
+    for (int i=0; i<3; i++)
+        pos[i] = -(view[4*i]*view[12] + view[4*i+1]*view[13] +
+                   view[4*i+2]*view[14]);
+}
+
+/* Tile under a world position, plants stand at their offset from the
+   start position */
+static void tileOf(const forest &f, const float pos[3], int &x, int &z)
+{
+    x = (int)floorf((pos[0] - STARTX)/f.tile_size + f.tiles_x/2.0f);
+    z = (int)floorf((pos[2] + STARTY)/f.tile_size + f.tiles_z/2.0f);
+}
+
+/* Unmap tile and take it off the budget */
+static void unmapTile(forest &f, forestTile &t)
+{
+    t.plants.clear();
+    munmap(t.map, t.bytes);
+    f.resident -= t.cost;
+}
+
+/* True if the tile in bytes of map was written for this build and every
+   plant's state tree lies inside it */
+static bool tileValid(const void *map, size_t bytes)
+{
+    const tileHeader *h = (const tileHeader *)map;
+    const tilePlant *table = (const tilePlant *)(h + 1);
+    if (memcmp(h->magic, FOREST_MAGIC, sizeof(h->magic)) != 0 ||
+        h->encoding != STATE_ENCODING ||
+        h->state_bytes != (int)sizeof(stored_state) || h->plants < 0 ||
+        sizeof(tileHeader) + h->plants*sizeof(tilePlant) > bytes)
+        return false;
+    int64_t table_end = sizeof(tileHeader) + h->plants*sizeof(tilePlant);
+    for (int j=0; j<h->plants; j++)
+    {
+        const tilePlant &tp = table[j];
+        if (tp.nextFree < 0 || tp.root < 0 || tp.root > tp.nextFree ||
+            tp.offset < table_end ||
+            tp.offset % alignof(stored_state) != 0 ||
+            (int64_t)bytes - tp.offset <
+                ((int64_t)tp.nextFree+1)*(int64_t)sizeof(stored_state))
+            return false;
+    }
+    return true;
+}
+
+/* Make tile most recently used, mapping it in if it is not. Returns NULL
+   if the tile is outside the forest or can't be read. */
+static forestTile *pageIn(forest &f, int x, int z)
+{
+    if (x < 0 || z < 0 || x >= f.tiles_x || z >= f.tiles_z)
+        return NULL;
+    int index = z*f.tiles_x + x;
+    auto i = f.index.find(index);
+    if (i != f.index.end())
+    {
+        f.tiles.splice(f.tiles.begin(), f.tiles, i->second);
+        return &f.tiles.front();
+    }
+
+    int fd = open(tileFile(f.dir, x, z).c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(tileHeader))
+    {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd,
+                     0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+    const tileHeader *h = (const tileHeader *)map;
+    const tilePlant *table = (const tilePlant *)(h + 1);
+    if (!tileValid(map, st.st_size))
+    {
+        fprintf(stderr, "%s: bad tile\n", tileFile(f.dir, x, z).c_str());
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    madvise(map, st.st_size, MADV_WILLNEED);
+
+    f.tiles.push_front(forestTile());
+    forestTile &t = f.tiles.front();
+    t.index = index;
+    t.map = map;
+    t.bytes = st.st_size;
+    t.cost = t.bytes;
+    t.needed = 0;
+    t.plants.resize(h->plants);
+    t.place.resize(16*h->plants);
+    for (int j=0; j<h->plants; j++)
+    {
+        const tilePlant &tp = table[j];
+        viewPlant(t.plants[j], (stored_state *)((char *)map + tp.offset),
+                  tp.nextFree, tp.root, tp.time_cur);
+        matIdentity(&t.place[16*j]);
+        matTranslate(&t.place[16*j], tp.x, 0, tp.z);
+        t.cost += sizeof(plant) + (tp.nextFree+1)*6*sizeof(float);
+    }
+    f.index[index] = f.tiles.begin();
+    f.resident += t.cost;
+    f.page_ins++;
+    return &t;
+}
+
+/* Open forest in dir, keeping about budget bytes of it mapped */
+bool forestOpen(forest &f, const char* dir, size_t budget)
+{
+    FILE *in = fopen((std::string(dir) + "/forest").c_str(), "r");
+    char line[512];
+    if (in == NULL)
+        return false;
+    f.dir = dir;
+    f.tiles_x = f.tiles_z = 0;
+    f.tile_size = 0;
+    while (fgets(line, sizeof(line), in))
+    {
+        line[strcspn(line, "\n")] = 0;
+        char *value = strchr(line, '=');
+        if (value == NULL)
+            continue;
+        *value++ = 0;
+        if (strcmp(line, "tiles_x") == 0)
+            f.tiles_x = atoi(value);
+        else if (strcmp(line, "tiles_z") == 0)
+            f.tiles_z = atoi(value);
+        else if (strcmp(line, "tile_size") == 0)
+            f.tile_size = atof(value);
+    }
+    fclose(in);
+    f.budget = budget;
+    f.resident = 0;
+    f.frame = 0;
+    f.page_ins = f.evictions = 0;
+    return f.tiles_x > 0 && f.tiles_z > 0 && f.tile_size > 0;
+}
+
+/* Drop least recently needed tiles until back under budget. Tiles needed
+   now are kept even over budget. */
+static void evict(forest &f)
+{
+    auto i = f.tiles.end();
+    while (f.resident > f.budget && i != f.tiles.begin())
+    {
+        --i;
+        if (i->needed == f.frame)
+            continue;
+        unmapTile(f, *i);
+        f.index.erase(i->index);
+        i = f.tiles.erase(i);
+        f.evictions++;
+    }
+}
+
+/* Map in the tiles around the camera, then those it is heading for while
+   they fit in the budget */
+void forestUpdate(forest &f, const float view[16])
+{
+    float pos[3], ahead[3];
+    cameraPosition(view, pos);
+    for (int i=0; i<3; i++)
+        ahead[i] = pos[i] + (f.frame > 0 ? (pos[i] - f.camera[i]) *
+                                           FOREST_LOOKAHEAD : 0);
+    memcpy(f.camera, pos, sizeof(f.camera));
+    f.frame++;
+
+    int cx, cz, ax, az;
+    tileOf(f, pos, cx, cz);
+    tileOf(f, ahead, ax, az);
+    for (int dz=-FOREST_RADIUS; dz<=FOREST_RADIUS; dz++)
+        for (int dx=-FOREST_RADIUS; dx<=FOREST_RADIUS; dx++)
+        {
+            forestTile *t = pageIn(f, cx+dx, cz+dz);
+            if (t)
+                t->needed = f.frame;
+        }
+    evict(f);
+
+    /* A prefetched tile stays mapped until the budget needs it back */
+    if (ax == cx && az == cz)
+        return;
+    for (int dz=-FOREST_RADIUS; dz<=FOREST_RADIUS; dz++)
+        for (int dx=-FOREST_RADIUS; dx<=FOREST_RADIUS; dx++)
+            if (f.resident < f.budget)
+                pageIn(f, ax+dx, az+dz);
+}
+
+/* Sink that places cones of a plant in the forest */
+static void placeCones(const cone *cones, int n, void *data)
+{
+    placedSink &s = *(placedSink *)data;
+    for (int i=0; i<n; i++)
+    {
+        s.cones[i] = cones[i];
+        matMultiply(s.cones[i].mat, s.place, cones[i].mat);
+    }
+    if (s.out->emit)
+        s.out->emit(s.cones, n, s.out->data);
+}
+
+/* Pass cones of plants on tiles around the camera to sink */
+void forestDraw(forest &f, coneSink &sink)
+{
+    placedSink placed;
+    coneSink to_placed = {placeCones, &placed};
+    placed.out = &sink;
+    for (auto i=f.tiles.begin(); i!=f.tiles.end(); i++)
+    {
+        if (i->needed != f.frame)
+            continue;
+        for (int j=0; j<(int)i->plants.size(); j++)
+        {
+            placed.place = &i->place[16*j];
+            generate(i->plants[j], to_placed);
+        }
+    }
+}
+
+/* Unmap every tile */
+void forestClose(forest &f)
+{
+    for (auto i=f.tiles.begin(); i!=f.tiles.end(); i++)
+        unmapTile(f, *i);
+    f.tiles.clear();
+    f.index.clear();
+}
+
+/* Grow the plants of one tile and write them to its file */
+static bool writeTile(const std::string &dir, int x, int z, int tiles_x,
+                      int tiles_z, float size, int per_tile,
+                      unsigned int seed, float time_from, float time_to,
+                      plant &p)
+{
+    std::default_random_engine rng(seed + z*tiles_x + x);
+    std::uniform_real_distribution<float> unit(0, 1);
+    std::vector<tilePlant> table(per_tile);
+    std::vector<char> states;
+    coneSink skip = {NULL, NULL};
+    int64_t offset = sizeof(tileHeader) + per_tile*sizeof(tilePlant);
+    for (int j=0; j<per_tile; j++)
+    {
+        tilePlant &tp = table[j];
+        memset(&tp, 0, sizeof(tp));
+        tp.x = (x + unit(rng) - tiles_x/2.0f)*size;
+        tp.z = (z + unit(rng) - tiles_z/2.0f)*size;
+        tp.time_cur = time_from + unit(rng)*(time_to - time_from);
+
+        /* Grow in small steps, as the plant would grow on screen */
+        initPlant(p);
+        seedPlant(p, rng());
+        while (p.time_cur + FOREST_STEP < tp.time_cur)
+        {
+            p.time_cur += FOREST_STEP;
+            generate(p, skip);
+        }
+        p.time_cur = tp.time_cur;
+        generate(p, skip);
+        tp.nextFree = p.nextFree;
+        tp.root = p.root;
+
+        /* States of each plant start 8 byte aligned */
+        tp.offset = offset + states.size();
+        size_t bytes = (p.nextFree+1)*sizeof(stored_state);
+        states.insert(states.end(), (char *)&p.states[0],
+                      (char *)&p.states[0] + bytes);
+        states.resize((states.size() + 7) & ~7);
+    }
+
+    tileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, FOREST_MAGIC, sizeof(h.magic));
+    h.encoding = STATE_ENCODING;
+    h.state_bytes = sizeof(stored_state);
+    h.plants = per_tile;
+    std::string name = tileFile(dir, x, z);
+    std::string tmp = name + ".tmp";
+    FILE *out = fopen(tmp.c_str(), "wb");
+    if (out == NULL)
+        return false;
+    fwrite(&h, sizeof(h), 1, out);
+    fwrite(&table[0], sizeof(tilePlant), per_tile, out);
+    if (!states.empty())
+        fwrite(&states[0], states.size(), 1, out);
+    bool ok = !ferror(out);
+    ok = fclose(out) == 0 && ok;
+    return ok && rename(tmp.c_str(), name.c_str()) == 0;
+}
+
+/* Grow a forest and write it to a directory of tiles */
+int forestMain(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        fprintf(stderr, "usage: plant-grow --make-forest <dir> [options]\n");
+        return 2;
+    }
+    std::string dir = argv[0];
+    int tiles_x = 16, tiles_z = 16;
+    float size = 40;
+    int per_tile = 6;
+    unsigned int seed = time(0);
+    float time_from = 3, time_to = 8;
+    for (int i=1; i<argc; i++)
+    {
+        bool more = i+1 < argc;
+        if (strcmp(argv[i], "--tiles") == 0 && i+2 < argc)
+        {
+            tiles_x = atoi(argv[++i]);
+            tiles_z = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--tile-size") == 0 && more)
+            size = atof(argv[++i]);
+        else if (strcmp(argv[i], "--per-tile") == 0 && more)
+            per_tile = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && more)
+            seed = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--time") == 0 && i+2 < argc)
+        {
+            time_from = atof(argv[++i]);
+            time_to = atof(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (tiles_x < 1 || tiles_z < 1 || size <= 0 || per_tile < 1 ||
+        time_from < 1 || time_to < time_from)
+    {
+        fprintf(stderr, "bad forest parameters\n");
+        return 2;
+    }
+
+    mkdir(dir.c_str(), 0777);
+    FILE *out = fopen((dir + "/forest").c_str(), "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "%s: can't write forest\n", dir.c_str());
+        return 1;
+    }
+    fprintf(out, "tiles_x=%d\ntiles_z=%d\ntile_size=%.9g\nper_tile=%d\n"
+            "seed=%u\ntime_from=%.9g\ntime_to=%.9g\n", tiles_x, tiles_z,
+            size, per_tile, seed, time_from, time_to);
+    fclose(out);
+
+    plant p;
+    for (int z=0; z<tiles_z; z++)
+    {
+        for (int x=0; x<tiles_x; x++)
+            if (!writeTile(dir, x, z, tiles_x, tiles_z, size, per_tile, seed,
+                           time_from, time_to, p))
+            {
+                fprintf(stderr, "%s: can't write tile\n",
+                        tileFile(dir, x, z).c_str());
+                return 1;
+            }
+        fprintf(stderr, "%s: %d of %d rows\n", dir.c_str(), z+1, tiles_z);
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+/******************************************************************************
+ *    File : forest.h
+ * Descrip : Header file for forests too big for memory. The forest is cut
+ *           into square tiles of plants stored on disk, and tiles near the
+ *           camera are mapped in while far ones are dropped.
+ *****************************************************************************/
+
+#pragma once
+
+#include "grow.h"
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Constants */
+#define FOREST_RADIUS 2                 /* Tiles drawn on each side of camera */
+#define FOREST_LOOKAHEAD 60             /* Frames of motion prefetched */
+#define FOREST_BUDGET 256               /* Default memory budget in MB */
+
+/* Types */
+typedef struct forestTile {
+    int index;                          /* tile_z*tiles_x + tile_x */
+    void *map;                          /* Mapped tile file */
+    size_t bytes;                       /* Size of mapping */
+    size_t cost;                        /* Bytes counted against budget */
+    std::vector<plant> plants;          /* Plants on states in mapping */
+    std::vector<float> place;           /* Placement of each plant, 16 each */
+    long needed;                        /* Frame tile was last drawn */
+} forestTile;
+
+typedef struct forest {
+    std::string dir;                    /* Directory of tile files */
+    int tiles_x, tiles_z;               /* Tiles across and deep */
+    float tile_size;                    /* Width of a tile */
+    size_t budget;                      /* Most bytes kept mapped */
+    size_t resident;                    /* Bytes mapped now */
+    long frame;                         /* Updates so far */
+    float camera[3];                    /* Camera position at last update */
+    std::list<forestTile> tiles;        /* Mapped tiles, most recent first */
+    std::unordered_map<int, std::list<forestTile>::iterator> index;
+    long page_ins, evictions;           /* Tiles mapped and dropped */
+} forest;
+
+/* Procedure prototypes */
+bool forestOpen(forest &f, const char* dir, size_t budget);
+void forestUpdate(forest &f, const float view[16]);
+void forestDraw(forest &f, coneSink &sink);
+void forestClose(forest &f);
+int forestMain(int argc, char** argv);
@@ -0,0 +1,104 @@
+/******************************************************************************
+ *    File : grid.cpp
+ * Descrip : Implementation file for the spatial hash grid. A cell is keyed
+ *           by its integer coordinates packed 21 bits each into 64 bits, and
+ *           found by linear probing. A cell that empties keeps its slot
+ *           with a count of zero until the table is next rebuilt.
+ *****************************************************************************/
+
+/* Include files */
+#include "grid.h"
+#include <math.h>                       /* Need math functions */
+
+/* Constants */
+#define GRID_BITS 21                    /* Bits per coordinate in key */
+#define GRID_MASK ((1 << GRID_BITS) - 1)
+#define GRID_START 1024                 /* Initial slots, a power of 2 */
+
+/* Empty grid */
+void gridInit(grid &g, float cell)
+{
+    g.cell = cell;
+    g.keys.assign(GRID_START, GRID_NONE);
+    g.counts.assign(GRID_START, 0);
+    g.used = 0;
+}
+
+/* Key of cell holding pos */
+uint64_t gridKey(const grid &g, const float pos[3])
+{
+    uint64_t key = 0;
+    for (int i=0; i<3; i++)
+        key = (key << GRID_BITS) |
+              ((uint64_t)(int64_t)floorf(pos[i]/g.cell) & GRID_MASK);
+    return key;
+}
+
+/* Key of a neighboring cell */
+uint64_t gridOffset(uint64_t key, int dx, int dy, int dz)
+{
+    uint64_t x = (key >> 2*GRID_BITS) + dx;
+    uint64_t y = (key >> GRID_BITS) + dy;
+    uint64_t z = key + dz;
+    return ((x & GRID_MASK) << 2*GRID_BITS) | ((y & GRID_MASK) << GRID_BITS) |
+           (z & GRID_MASK);
+}
+
+/* Slot holding key, or the empty slot where it would go */
+static inline int findSlot(const grid &g, uint64_t key)
+{
+    int mask = g.keys.size() - 1;
+    int slot = (int)((key * 0x9E3779B97F4A7C15ULL) >> 40) & mask;
+    while (g.keys[slot] != key && g.keys[slot] != GRID_NONE)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+/* Rebuild the table when it is half full, dropping empty cells, and double
+   it if those were not enough to bring it down to a quarter */
+static void grow(grid &g)
+{
+    int live = 0;
+    for (int i=0; i<(int)g.keys.size(); i++)
+        live += g.keys[i] != GRID_NONE && g.counts[i] != 0;
+    int size = g.keys.size();
+    if (4*(live + 1) > size)
+        size *= 2;
+    std::vector<uint64_t> keys(size, GRID_NONE);
+    std::vector<int> counts(size, 0);
+    keys.swap(g.keys);
+    counts.swap(g.counts);
+    g.used = 0;
+    for (int i=0; i<(int)keys.size(); i++)
+        if (keys[i] != GRID_NONE && counts[i] != 0)
+        {
+            int slot = findSlot(g, keys[i]);
+            g.keys[slot] = keys[i];
+            g.counts[slot] = counts[i];
+            g.used++;
+        }
+}
+
+/* Add delta nodes to cell */
+void gridAdd(grid &g, uint64_t key, int delta)
+{
+    int slot = findSlot(g, key);
+    if (g.keys[slot] == GRID_NONE)
+    {
+        if (2*(g.used + 1) > (int)g.keys.size())
+        {
+            grow(g);
+            slot = findSlot(g, key);
+        }
+        g.keys[slot] = key;
+        g.used++;
+    }
+    g.counts[slot] += delta;
+}
+
+/* Nodes in cell */
+int gridCount(const grid &g, uint64_t key)
+{
+    int slot = findSlot(g, key);
+    return g.keys[slot] == GRID_NONE ? 0 : g.counts[slot];
+}
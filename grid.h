@@ -0,0 +1,28 @@
+/******************************************************************************
+ *    File : grid.h
+ * Descrip : Header file for a uniform spatial hash grid that counts how many
+ *           plant nodes are in each cell of space
+ *****************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+/* Constants */
+#define GRID_NONE (~(uint64_t)0)        /* Key of no cell */
+
+/* Types */
+typedef struct grid {
+    float cell;                         /* Size of a cell */
+    std::vector<uint64_t> keys;         /* Cell keys, open addressing */
+    std::vector<int> counts;            /* Nodes in each cell */
+    int used;                           /* Slots with a key */
+} grid;
+
+/* Procedure prototypes */
+void gridInit(grid &g, float cell);
+uint64_t gridKey(const grid &g, const float pos[3]);
+uint64_t gridOffset(uint64_t key, int dx, int dy, int dz);
+void gridAdd(grid &g, uint64_t key, int delta);
+int gridCount(const grid &g, uint64_t key);
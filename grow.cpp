@@ -0,0 +1,685 @@
+/******************************************************************************
+ *    File : grow.cpp
+ * Descrip : Implementation file for growing the state tree and generating
+ *           the cones that make up the plant
+ *****************************************************************************/
+
+/* Include files */
+#include "grow.h"
+#include "dag.h"
+#include "growth.h"
+#include "matrix.h"
+#include <algorithm>
+#include <fstream>
+#include <stdlib.h>
+#include <string.h>                     /* String operations */
+
+/* Forget where nodes are and let them all grow freely again */
+static void clearSurroundings(plant &p)
+{
+    p.env_frame = 0;
+#if SURROUNDINGS
+    gridInit(p.env_grid, ENV_CELL);
+    p.node_cell.assign(p.capacity+1, GRID_NONE);
+    p.node_weight.assign(p.capacity+1, 0);
+    p.node_light.assign(p.capacity+1, 1);
+    p.node_env.assign(p.capacity+1, 1);
+#endif
+}
+
+/* Branching parameters set in params.h */
+void defaultSpecies(species &kind)
+{
+    kind.azim_spin = AZIM_SPIN;
+    kind.turn_spin = TURN_SPIN;
+    kind.branch_per_apex = BRANCH_PER_APEX;
+    kind.leaf_outward_angle = LEAF_OUTWARD_ANGLE;
+    kind.leaf_to_twig_ratio = LEAF_TO_TWIG_RATIO;
+    kind.big_azim_spin = BIG_AZIM_SPIN;
+    kind.big_turn_spin = BIG_TURN_SPIN;
+    kind.big_branch_per_apex = BIG_BRANCH_PER_APEX;
+    kind.big_leaf_outward_angle = BIG_LEAF_OUTWARD_ANGLE;
+}
+
+/* Size the per node arrays for a tree of up to capacity states and start
+   over at the first state */
+static void sizePlant(plant &p, int capacity)
+{
+    p.capacity = capacity;
+    p.nextFree = 0;
+    p.time_cur = 1;
+    p.frame_free = 0;
+    p.renumbers = 0;
+    p.node_aged.assign(capacity+1, false);
+    p.node_shared.assign(capacity+1, false);
+    p.node_age.assign(capacity+1, 0);
+    p.node_time.assign(capacity+1, 0);
+    p.node_factor.assign(capacity+1, 0);
+    p.node_color.assign(3*(capacity+1), 0);
+    p.root = 0;
+    clearParts(p);
+    clearSurroundings(p);
+    p.rng.seed(std::default_random_engine::default_seed);
+    defaultSpecies(p.kind);
+}
+
+/* Set up an empty plant */
+void initPlant(plant &p)
+{
+    p.states.assign(STATE_SIZE+1, stored_state());
+    sizePlant(p, STATE_SIZE);
+    setChild(p.states[0], NONE);
+    setSibling(p.states[0], NONE);
+}
+
+/* Set up a plant on a state tree owned elsewhere, such as a mapped file.
+   The tree should already be grown to time_cur. It can't grow, so the
+   arrays are only as big as it, and generating it later than that ends
+   each branch where a node would be made. */
+void viewPlant(plant &p, stored_state *states, int nextFree, int root,
+               float time_cur)
+{
+    sizePlant(p, nextFree);
+    p.states.view(states, nextFree+1);
+    p.nextFree = nextFree;
+    p.root = root;
+    p.time_cur = time_cur;
+}
+
+/* Seed the random numbers a stocastic plant grows with. Each plant has its
+   own, so plants grown side by side don't disturb each other. */
+void seedPlant(plant &p, unsigned int seed)
+{
+    p.rng.seed(seed);
+}
+
+/* Save state tree, every node up to nextFree. False if it can't be
+   written. */
+bool save_state(const plant &p, const char* filename, const float view[16])
+{
+    std::ofstream out(filename, std::ios::out|std::ios::binary);
+    out.write((char *)view, 16*sizeof(float)); /* write view matrix */
+    out.write((char *)&p.time_cur, sizeof(p.time_cur)); /* write cur time */
+    out.write((char *)&p.nextFree, sizeof(p.nextFree)); /* write size of state tree */
+    for (int i=0; i<=p.nextFree; i++) {    /* write state tree */
+        state s;
+        unpackState(p.states[i], s);
+        out.write((char *)&s, sizeof(s));
+    }
+    out.close();
+    return !out.fail();
+}
+
+/* Load state tree. Returns false, leaving plant and view as they were, if
+   the file can't be read, is cut short, or holds a tree that doesn't fit
+   the plant or links outside itself. Files saved before save_state wrote
+   the node at nextFree are one node short; that node, always the newest,
+   is dropped and made again when the plant next grows. */
+bool load_state(plant &p, const char* filename, float view[16])
+{
+    std::ifstream in(filename, std::ios::in|std::ios::binary);
+    float at[16], time_cur;
+    int nextFree;
+    in.read((char *)at, sizeof(at));    /* read view matrix */
+    in.read((char *)&time_cur, sizeof(time_cur)); /* read cur time */
+    in.read((char *)&nextFree, sizeof(nextFree)); /* read size of state tree */
+    if (!in || nextFree < 0 || nextFree > p.capacity)
+        return false;
+    std::vector<state> states(nextFree+1);
+    in.read((char *)&states[0], states.size()*sizeof(state)); /* read state tree */
+    if (!in && nextFree > 0 && in.gcount() == nextFree*(int)sizeof(state))
+    {
+        states.pop_back();              /* Older file, newest node missing */
+        for (int i=0; i<nextFree; i++)
+        {
+            if (states[i].child == nextFree)
+                states[i].child = NONE;
+            if (states[i].sibling == nextFree)
+                states[i].sibling = NONE;
+        }
+        nextFree--;
+    }
+    else if (!in)
+        return false;
+    for (int i=0; i<=nextFree; i++)
+    {
+        const state &s = states[i];
+        if ((s.child != NONE && (s.child <= 0 || s.child > nextFree)) ||
+            (s.sibling != NONE && (s.sibling <= 0 || s.sibling > nextFree)))
+            return false;
+    }
+
+    memcpy(view, at, sizeof(at));
+    p.time_cur = time_cur;
+    p.nextFree = nextFree;
+    for (int i=0; i<=nextFree; i++)
+        packState(p.states[i], states[i]);
+    p.node_aged.assign(p.node_aged.size(), false); /* node ages are not valid */
+    p.node_shared.assign(p.node_shared.size(), false);
+    clearSurroundings(p);
+    return true;
+}
+
+/* Values of node and size of the subtree reached through its links, in a
+   tree of count states with the growth time and factor of each. With
+   shared subtrees a node is counted each time it is reached. */
+bool inspectNode(const stored_state *states, const float *time,
+                 const float *factor, int count, int node, nodeInfo &info)
+{
+    if (node < 0 || node >= count)
+        return false;
+    unpackState(states[node], info.s);
+    info.time = time[node];
+    info.factor = factor[node];
+    info.nodes = info.depth = info.tips = 0;
+
+    std::vector<std::pair<int, int> > stack(1, std::make_pair(node, 1));
+    while (!stack.empty())
+    {
+        int at = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+        int child = getChild(states[at]);
+        int sibling = getSibling(states[at]);
+        info.nodes++;
+        info.depth = std::max(info.depth, depth);
+        if (child == NONE && sibling == NONE)
+            info.tips++;
+        if (child != NONE)
+            stack.push_back(std::make_pair(child, depth+1));
+        if (sibling != NONE)
+            stack.push_back(std::make_pair(sibling, depth+1));
+    }
+    return true;
+}
+
+/* Types */
+typedef struct branch {
+    int level;                          /* 1 for twig, else branch of level-1 */
+    int link;                           /* Link to current apex node */
+    int mystate;                        /* Current apex node */
+    float mytime;                       /* Time of current apex node */
+    float size_bot, size_top;           /* Radius at bottom & top of apex */
+    float size;
+    float deg, azimuth;
+    int rule;                           /* Number of siblings of apex */
+    float spin;                         /* Azimuth between siblings */
+    int sibling;                        /* Siblings done, -1 if apex not begun */
+    int sibling_link;                   /* Link to current sibling */
+    int part;                           /* Part cones go to, -1 for sink */
+    float mat[16];                      /* Transform at top of apex */
+} branch;
+
+typedef struct coneChunk {
+    coneSink *sink;                     /* Where full chunks go */
+    cone cones[GEOM_CHUNK];             /* Cones not yet passed to sink */
+    int n;                              /* Number of cones in chunk */
+} coneChunk;
+
+static void flushCones(coneChunk &out);
+
+/* Growth factor of a node. Nodes seen before use this frame's batch result;
+   others are evaluated alone and their age remembered for later frames. A
+   node made this frame is skipped as it starts at its own time offset. A
+   node reached at several times, as a shared node or as both the leaf at
+   the tip of a twig and the first apex of the twig it sprouts, has no one
+   age, so it is always evaluated. */
+static inline float nodeGrowth(plant &p, int mystate, float mytime)
+{
+    if (!INSTANCING && p.node_aged[mystate] && !p.node_shared[mystate] &&
+        fabsf(mytime - p.time_cur - p.node_age[mystate]) > AGE_SAME)
+        p.node_shared[mystate] = true;
+    if (INSTANCING || !p.node_aged[mystate] || p.node_shared[mystate])
+    {
+        growthBatch(&mytime, &p.node_factor[mystate],
+                    &p.node_color[3*mystate], 1, GROWTH_ACCURACY);
+        p.node_age[mystate] = mytime - p.time_cur;
+        p.node_aged[mystate] = mystate <= p.frame_free;
+    }
+    return p.node_factor[mystate];
+}
+
+/* Evaluate growth of all nodes in one pass. A node's growth time is time_cur
+   plus a fixed age, since the traversal only offsets time. */
+static void growAll(plant &p)
+{
+    p.frame_free = p.nextFree;
+    if (INSTANCING)
+        return;
+    for (int i=0; i<=p.nextFree; i++)
+        p.node_time[i] = p.time_cur + p.node_age[i];
+    growthBatch(&p.node_time[0], &p.node_factor[0], &p.node_color[0],
+                p.nextFree+1, GROWTH_ACCURACY);
+}
+
+/* Share of its growth a node gets from its surroundings */
+static inline float nodeEnv(const plant &p, int mystate)
+{
+#if SURROUNDINGS
+    return p.node_env[mystate];
+#else
+    (void)p;
+    (void)mystate;
+    return 1;
+#endif
+}
+
+/* Count a node in the cell holding the middle of its cone, weighted by the
+   area of the cone. Nodes are moved and reweighed every ENV_INTERVAL frames,
+   a different share each frame, and then ask the grid how much area in the
+   column above shades them and how much around crowds them. Growth eases
+   towards the light that is left a little each frame so the plant does not
+   jump. */
+static inline void placeNode(plant &p, int mystate, const float mat[16],
+                             float rad, float height)
+{
+#if SURROUNDINGS
+    uint64_t &cell = p.node_cell[mystate];
+    int &weight = p.node_weight[mystate];
+    float &env = p.node_env[mystate];
+    if (cell != GRID_NONE && (mystate + p.env_frame) % ENV_INTERVAL != 0)
+    {
+        env += (p.node_light[mystate] - env)*ENV_EASE;
+        return;
+    }
+    const float local[3] = {0, 0, height/2};
+    float mid[3];
+    matPoint(mat, local, mid);
+    uint64_t key = gridKey(p.env_grid, mid);
+    if (cell != GRID_NONE)
+        gridAdd(p.env_grid, cell, -weight);
+    weight = (int)(rad*height/ENV_AREA) + 1;
+    gridAdd(p.env_grid, key, weight);
+    cell = key;
+
+    /* Up is +y once the plant is stood up by generate */
+    int crowd = gridCount(p.env_grid, key) - weight;
+    crowd += gridCount(p.env_grid, gridOffset(key, -1, 0, 0));
+    crowd += gridCount(p.env_grid, gridOffset(key, 1, 0, 0));
+    crowd += gridCount(p.env_grid, gridOffset(key, 0, -1, 0));
+    crowd += gridCount(p.env_grid, gridOffset(key, 0, 1, 0));
+    crowd += gridCount(p.env_grid, gridOffset(key, 0, 0, -1));
+    crowd += gridCount(p.env_grid, gridOffset(key, 0, 0, 1));
+    int shade = 0;
+    for (int i=1; i<=ENV_REACH; i++)
+        shade += gridCount(p.env_grid, gridOffset(key, 0, i, 0));
+    const float per_area = ENV_AREA/(ENV_CELL*ENV_CELL);
+    float light = 1/((1 + ENV_CROWD*per_area*crowd)*
+                     (1 + ENV_SHADE*per_area*shade));
+    p.node_light[mystate] = light > ENV_MIN ? light : ENV_MIN;
+    env += (p.node_light[mystate] - env)*ENV_EASE;
+#else
+    (void)p;
+    (void)mystate;
+    (void)mat;
+    (void)rad;
+    (void)height;
+#endif
+}
+
+/* Function that returns a uniform random variable */
+float uniform(plant &p, float mu, float sigma)
+{
+    std::uniform_real_distribution<double> distribution(0, 1);
+    return mu - sigma/2 + distribution(p.rng) * sigma;
+}
+
+/* Use std library to return a guassian distribution random variable */
+float guassian(plant &p, float m, float s)
+{
+    std::normal_distribution<double> distribution(m, s);
+    return distribution(p.rng);
+}
+
+/* Node that a link refers to: the root, or a child or sibling field */
+static inline int getLink(const plant &p, int link)
+{
+    if (link == ROOT_LINK)
+        return p.root;
+    const stored_state &owner = p.states[link >> 1];
+    return (link & 1) ? getSibling(owner) : getChild(owner);
+}
+
+static inline void setLink(plant &p, int link, int node)
+{
+    if (link == ROOT_LINK)
+        p.root = node;
+    else if (link & 1)
+        setSibling(p.states[link >> 1], node);
+    else
+        setChild(p.states[link >> 1], node);
+}
+
+/* Retrieve state from state tree, making it if the link is empty. If no
+   node can be made, as the tree is full or is a view of states owned
+   elsewhere, mystate is NONE and the branch ends there. */
+static inline int nextState(plant &p, int link, int &mystate, float &size,
+                            float &deg, float &azimuth, float &mytime)
+{
+    state s;
+    mystate = getLink(p, link);
+    if (mystate != NONE)
+    {
+        unpackState(p.states[mystate], s);
+        size = s.size;
+        deg = s.deg;
+        azimuth = s.azimuth;
+        mytime += s.mytime;
+        return s.rule;
+    }
+    else if (p.nextFree >= p.capacity)
+        return 0;
+
+    mystate = ++p.nextFree;
+    setLink(p, link, mystate);
+#if STOCASTIC_PLANT == 1
+    s.size = RAND_DIST(p, size, size/3);
+    s.deg = RAND_DIST(p, deg, 20);
+    s.azimuth = RAND_DIST(p, azimuth, 180);
+    s.mytime = RAND_DIST(p, -0.25, 0.5);
+    s.rule = (int)RAND_DIST(p, 2.5, 2); /* 1,2,3 */
+#else
+    s.size = size;
+    s.deg = deg;
+    s.azimuth = azimuth;
+#if INSTANCING
+    s.azimuth -= 360*floorf(azimuth/360); /* Same turn, same node */
+#endif
+    s.mytime = 0;
+    s.rule = 2;
+#endif
+    s.child = NONE;
+    s.sibling = NONE;
+    packState(p.states[mystate], s);
+
+    // Update passed parameters with what was stored, so a compact node
+    // looks the same now as when it is read back
+    unpackState(p.states[mystate], s);
+    size = s.size;
+    deg = s.deg;
+    azimuth = s.azimuth;
+#if STOCASTIC_PLANT == 1
+    mytime = s.mytime;
+#endif
+    return s.rule;
+}
+
+/* Add a cone for a node to a part, or to the chunk if part is -1, flushing
+   the chunk to the sink when full */
+static inline void addCone(plant &p, coneChunk &out, int part,
+                           const float mat[16], float rad, float rad2,
+                           float height, int mystate)
+{
+    if (part >= 0)
+        p.parts[part].cones.push_back(cone());
+    cone &c = part >= 0 ? p.parts[part].cones.back() : out.cones[out.n++];
+    memcpy(c.mat, mat, sizeof(c.mat));
+    c.rad = rad;
+    c.rad2 = rad2;
+    c.height = height;
+    memcpy(c.color, &p.node_color[3*mystate], sizeof(c.color));
+    c.node = mystate;
+    if (part < 0 && out.n == GEOM_CHUNK)
+        flushCones(out);
+}
+
+/* Pass cones in chunk to sink and empty it */
+static void flushCones(coneChunk &out)
+{
+    if (out.n > 0 && out.sink->emit)
+        out.sink->emit(out.cones, out.n, out.sink->data);
+    out.n = 0;
+}
+
+/* Start a branch of the given level, linked from link */
+static void pushBranch(std::vector<branch> &stack, int level, int link,
+                       int part, const float mat[16], float mytime,
+                       float size_bot, float size, float deg, float azimuth)
+{
+    /* mat may point into the stack, which can move as it grows */
+    float at[16];
+    memcpy(at, mat, sizeof(at));
+    stack.push_back(branch());
+    branch &b = stack.back();
+    b.level = level;
+    b.link = link;
+    b.mytime = mytime;
+    b.size_bot = size_bot;
+    b.size = size;
+    b.deg = deg;
+    b.azimuth = azimuth;
+    b.sibling = -1;
+    b.part = part;
+    memcpy(b.mat, at, sizeof(b.mat));
+}
+
+/* With instancing, place the part for the subtree at node instead of
+   generating it again. Returns true if the part is new and the caller must
+   generate it. */
+static bool placePart(plant &p, int owner, const float mat[16], int level,
+                      int node, float mytime, float size_bot, int &part)
+{
+    partKey key = {level, node, mytime, size_bot};
+    bool made;
+    part = findPart(p, key, made);
+    addPartRef(p, owner, part, mat);
+    return made;
+}
+
+/* Leaf at the tip of a twig, which may itself sprout a branch */
+static void genLeaf(plant &p, coneChunk &out, std::vector<branch> &stack,
+                    int part, const float mat[16], float mytime,
+                    float size_bot, float deg, float azimuth, int link)
+{
+    /* Base case */
+    if (size_bot <= 0 || mytime < 0)
+        return;
+
+    int mystate;
+    float size = INIT_SIZE*p.kind.leaf_to_twig_ratio;
+    int rule = nextState(p, link, mystate, size, deg, azimuth, mytime);
+    if (mystate == NONE)
+        return;
+
+    float factor = nodeGrowth(p, mystate, mytime)*nodeEnv(p, mystate);
+    size *= factor;
+    deg *= factor;
+
+    if (rule == 2)
+    {
+        float leaf[16];
+        memcpy(leaf, mat, sizeof(leaf));
+        matRotateY(leaf, p.kind.turn_spin);
+        matRotateZ(leaf, azimuth);
+        matRotateY(leaf, deg);
+#if GREEN_LEAVES==1
+        const float green[] = {GREEN};
+        memcpy(&p.node_color[3*mystate], green, sizeof(green));
+#endif
+        addCone(p, out, part, leaf, size_bot, 0.02*size_bot, size*size_bot,
+                mystate);
+        placeNode(p, mystate, leaf, size_bot, size*size_bot);
+    }
+#if LEAF_BRANCHING == 1
+    else if (rule == 1)
+        pushBranch(stack, 1, mystate << 1, part, mat, mytime-0.5, size_bot,
+                   size_bot, deg, azimuth);
+    else
+        pushBranch(stack, 2, mystate << 1, part, mat, mytime-0.5, size_bot,
+                   INIT_SIZE, deg, azimuth);
+#endif
+}
+
+/* Take one step of the branch on top of the stack. A branch walks up its
+   chain of apex nodes; at each apex it draws a cone, then its siblings
+   (leaves for twigs, branches one level down otherwise), then turns and
+   moves on to the child apex. */
+static void stepBranch(plant &p, coneChunk &out, std::vector<branch> &stack)
+{
+    branch &b = stack.back();
+    bool twig = b.level == 1;
+
+    /* Start apex node */
+    if (b.sibling < 0)
+    {
+        // Base case
+        if (b.mytime < 0)
+        {
+            stack.pop_back();
+            return;
+        }
+        b.rule = nextState(p, b.link, b.mystate, b.size, b.deg, b.azimuth,
+                           b.mytime);
+        if (b.mystate == NONE)
+        {
+            stack.pop_back();
+            return;
+        }
+        b.rule *= twig ? p.kind.branch_per_apex :
+                         p.kind.big_branch_per_apex;
+        b.spin = 0;
+        if (b.rule > 0)
+            b.spin = 360/b.rule;
+        float factor = nodeGrowth(p, b.mystate, b.mytime-0.5)*
+                       nodeEnv(p, b.mystate);
+        b.size_top = INIT_SIZE * factor;
+        if (twig)
+            b.deg *= factor;
+
+        matRotateZ(b.mat, b.azimuth);
+        matRotateY(b.mat, b.deg);
+        addCone(p, out, b.part, b.mat, b.size_bot, b.size_top, b.size_bot*10,
+                b.mystate);
+        placeNode(p, b.mystate, b.mat, b.size_bot, b.size_bot*10);
+        matTranslate(b.mat, 0, 0, b.size_bot*10);
+        b.sibling = 0;
+        b.sibling_link = (b.mystate << 1) | 1;
+        return;
+    }
+
+    /* Next sibling, linked from the previous one if that was made */
+    if (b.sibling < b.rule)
+    {
+        if (b.sibling > 0 && getLink(p, b.sibling_link) != NONE)
+            b.sibling_link = (getLink(p, b.sibling_link) << 1) | 1;
+        b.sibling++;
+        float azimuth = b.azimuth;
+        b.azimuth += b.spin;
+
+        /* b is not valid once the stack grows */
+        if (twig)
+        {
+            genLeaf(p, out, stack, b.part, b.mat, b.mytime, b.size_top,
+                    p.kind.leaf_outward_angle, azimuth, b.sibling_link);
+            return;
+        }
+        int node = getLink(p, b.sibling_link);
+        if (INSTANCING && node != NONE && b.mytime >= 0)
+        {
+            int part;
+            float mat[16];
+            if (!placePart(p, b.part, b.mat, b.level-1, node, b.mytime,
+                           b.size_top, part))
+                return;
+            matIdentity(mat);
+            pushBranch(stack, b.level-1, b.sibling_link, part, mat, b.mytime,
+                       b.size_top, INIT_SIZE, p.kind.big_leaf_outward_angle,
+                       azimuth);
+        }
+        else
+            pushBranch(stack, b.level-1, b.sibling_link, b.part, b.mat,
+                       b.mytime, b.size_top, INIT_SIZE,
+                       p.kind.big_leaf_outward_angle, azimuth);
+        return;
+    }
+
+    /* Undo rotational transformation and move on to child */
+    matRotateY(b.mat, -b.deg + (twig ? p.kind.turn_spin :
+                                       p.kind.big_turn_spin));
+    matRotateZ(b.mat, -b.azimuth + (twig ? p.kind.azim_spin :
+                                           p.kind.big_azim_spin));
+    b.link = b.mystate << 1;
+    b.mytime -= 0.5;
+    b.size_bot = b.size_top;
+    b.sibling = -1;
+
+    /* With instancing, the rest of the chain is a part of its own */
+    int node = getLink(p, b.link);
+    if (INSTANCING && node != NONE && b.mytime >= 0)
+    {
+        int part;
+        if (!placePart(p, b.part, b.mat, b.level, node, b.mytime, b.size_bot,
+                       part))
+        {
+            stack.pop_back();
+            return;
+        }
+        b.part = part;
+        matIdentity(b.mat);
+    }
+}
+
+/* Grow state tree to current time and pass the cones for the whole plant to
+   sink, GEOM_CHUNK at a time. Memory used is bounded by the depth of the
+   hierarchy, not by the size of the plant. With instancing, the plant is
+   first built as parts, each unique subtree once, and then sent to sink.
+   New states are shared before the parts are sent, so the node of each cone
+   is its number after the sharing. */
+void generate(plant &p, coneSink &sink)
+{
+    std::vector<branch> stack;
+    coneChunk out;
+    float mat[16], root[16];
+    float size_bot;
+    int before = p.nextFree;
+    int part = -1;
+
+    out.sink = &sink;
+    out.n = 0;
+    growAll(p);
+    growthBatch(&p.time_cur, &size_bot, NULL, 1, GROWTH_ACCURACY);
+    size_bot *= INIT_SIZE;
+
+    matIdentity(root);
+    matRotateX(root, -90);
+    matTranslate(root, STARTX, STARTY, STARTZ);
+    memcpy(mat, root, sizeof(mat));
+#if INSTANCING
+    bool made;
+    clearParts(p);
+    part = findPart(p, partKey(), made);
+    matIdentity(mat);
+#endif
+    pushBranch(stack, TREE_DEPTH, ROOT_LINK, part, mat, p.time_cur, size_bot,
+               INIT_SIZE, 0, 0);
+    while (!stack.empty())
+        stepBranch(p, out, stack);
+    flushCones(out);
+    p.env_frame++;
+
+#if INSTANCING
+    std::vector<int> moved;
+    if (p.nextFree != before && dedupStates(p, moved))
+        for (int i=0; i<p.nparts; i++)
+            for (int j=0; j<(int)p.parts[i].cones.size(); j++)
+                p.parts[i].cones[j].node = moved[p.parts[i].cones[j].node];
+    emitParts(p, root, sink);
+#else
+    (void)before;
+#endif
+}
+
+/* Sink that appends cones to a vector */
+static void appendCones(const cone *cones, int n, void *data)
+{
+    std::vector<cone> *all = (std::vector<cone> *)data;
+    all->insert(all->end(), cones, cones + n);
+}
+
+/* Grow state tree to current time and generate cones for the whole plant */
+void generate(plant &p, std::vector<cone> &cones)
+{
+    coneSink sink = {appendCones, &cones};
+    cones.clear();
+    generate(p, sink);
+}
@@ -0,0 +1,171 @@
+/******************************************************************************
+ *    File : grow.h
+ * Descrip : Header file for growing the state tree and generating geometry
+ *****************************************************************************/
+
+#pragma once
+
+#include "params.h"
+#include "compact.h"
+#include "grid.h"
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+/* Constants */
+#define GEOM_CHUNK 256                  /* Cones passed to a sink at once */
+#define ROOT_LINK -2                    /* Link to root of state tree */
+#define INSTANCING (DAG_INSTANCING == 1 && STOCASTIC_PLANT == 0)
+#define SURROUNDINGS (ENVIRONMENT == 1 && !INSTANCING)
+#define ENV_CELL 2.0                    /* Size of a cell of space */
+#define ENV_AREA 0.01                   /* Cone area counted as 1 in grid */
+#define ENV_REACH 4                     /* Cells above a node that shade it */
+#define ENV_SHADE 0.1                   /* Growth lost per area above */
+#define ENV_CROWD 0.02                  /* Growth lost per area around */
+#define ENV_MIN 0.25                    /* Least growth allowed */
+#define ENV_INTERVAL 8                  /* Frames between queries of a node */
+#define ENV_EASE 0.05                   /* Fraction of change taken a frame */
+#define AGE_SAME 1e-3                   /* Ages closer than this are equal */
+
+/* Types */
+typedef struct cone {
+    float mat[16];                      /* Transform of cone base */
+    float rad, rad2;                    /* Bottom and top radius */
+    float height;                       /* Height along z axis */
+    float color[3];                     /* Diffuse color */
+    int node;                           /* State that generated this cone */
+} cone;
+
+/* Receives generated cones in chunks, emit may be NULL to discard them */
+typedef struct coneSink {
+    void (*emit)(const cone *cones, int n, void *data);
+    void *data;
+} coneSink;
+
+/* Geometry of a subtree, generated once a frame however often it occurs */
+typedef struct partRef {
+    int part;                           /* Index in plant parts */
+    float mat[16];                      /* Placement relative to owner */
+} partRef;
+
+typedef struct part {
+    std::vector<cone> cones;            /* Cones relative to part */
+    std::vector<partRef> refs;          /* Parts placed inside this one */
+} part;
+
+/* A subtree looks the same wherever its apex node is reached at the same
+   time and size, since the node overrides the other branch parameters */
+typedef struct partKey {
+    int level;                          /* Branch level */
+    int node;                           /* Apex node */
+    float mytime;                       /* Time of apex node */
+    float size_bot;                     /* Radius at bottom of apex */
+    bool operator==(const partKey &k) const
+    {
+        return level == k.level && node == k.node && mytime == k.mytime &&
+               size_bot == k.size_bot;
+    }
+} partKey;
+
+typedef struct partHash {
+    size_t operator()(const partKey &k) const;
+} partHash;
+
+/* Branching parameters of a plant, params.h gives the defaults */
+typedef struct species {
+    float azim_spin;                    /* Azimuth spin per twig apex */
+    float turn_spin;                    /* Turning of twig per apex */
+    int branch_per_apex;                /* Leaves per twig apex */
+    float leaf_outward_angle;           /* Angle leaf makes with apex */
+    float leaf_to_twig_ratio;           /* Leaf size relative to twig */
+    float big_azim_spin;                /* Same for bigger branches */
+    float big_turn_spin;
+    int big_branch_per_apex;
+    float big_leaf_outward_angle;
+} species;
+
+/* State tree storage, owned by the plant or a view of memory owned by
+   someone else, such as a mapped file */
+typedef struct stateArray {
+    std::vector<stored_state> owned;    /* Storage when owned */
+    stored_state *base;                 /* First state */
+    int count;                          /* Number of states */
+
+    stateArray() : base(NULL), count(0) {}
+    stateArray(const stateArray &a) : base(NULL), count(0) { *this = a; }
+    stateArray &operator=(const stateArray &a)
+    {
+        bool own = a.base == a.owned.data();
+        owned = a.owned;
+        base = own ? owned.data() : a.base;
+        count = a.count;
+        return *this;
+    }
+    void assign(int n, const stored_state &s)
+    {
+        owned.assign(n, s);
+        base = owned.data();
+        count = n;
+    }
+    void view(stored_state *states, int n)
+    {
+        std::vector<stored_state>().swap(owned);
+        base = states;
+        count = n;
+    }
+    bool empty() const { return count == 0; }
+    int size() const { return count; }
+    stored_state *begin() { return base; }
+    stored_state &operator[](int i) { return base[i]; }
+    const stored_state &operator[](int i) const { return base[i]; }
+} stateArray;
+
+typedef struct plant {
+    stateArray states;                  /* State hierarchy */
+    int capacity;                       /* Most states tree can grow to */
+    int root;                           /* Root of state tree */
+    int nextFree;                       /* Next free state available */
+    float time_cur;                     /* Current time in animation */
+    int frame_free;                     /* Value of nextFree at frame start */
+    int renumbers;                      /* Times dedupStates renumbered states */
+    std::vector<bool> node_aged;        /* True if node_age is known */
+    std::vector<bool> node_shared;      /* Reached at more than one age */
+    std::vector<float> node_age;        /* Growth time minus time_cur */
+    std::vector<float> node_time;       /* Growth time this frame */
+    std::vector<float> node_factor;     /* Growth factor this frame */
+    std::vector<float> node_color;      /* Color this frame */
+    std::vector<part> parts;            /* Unique subtrees this frame */
+    int nparts;                         /* Parts in use */
+    std::unordered_map<partKey, int, partHash> part_index; /* Part of key */
+    grid env_grid;                      /* Nodes in each cell of space */
+    std::vector<uint64_t> node_cell;    /* Cell node is counted in */
+    std::vector<int> node_weight;       /* Area node is counted as */
+    std::vector<float> node_light;      /* Growth surroundings allow */
+    std::vector<float> node_env;        /* Growth factor eased to light */
+    int env_frame;                      /* Frames generated */
+    std::default_random_engine rng;     /* Random numbers of stocastic plant */
+    species kind;                       /* Branching parameters */
+} plant;
+
+/* A node of the state tree and the subtree below it */
+typedef struct nodeInfo {
+    state s;                            /* Stored values and links */
+    float time;                         /* Growth time last frame */
+    float factor;                       /* Growth factor last frame */
+    int nodes;                          /* Nodes in subtree, itself included */
+    int depth;                          /* Longest chain of links from it */
+    int tips;                           /* Nodes in subtree without links */
+} nodeInfo;
+
+/* Procedure prototypes */
+void initPlant(plant &p);
+void viewPlant(plant &p, stored_state *states, int nextFree, int root,
+               float time_cur);
+void seedPlant(plant &p, unsigned int seed);
+void defaultSpecies(species &kind);
+void generate(plant &p, coneSink &sink);
+void generate(plant &p, std::vector<cone> &cones);
+bool save_state(const plant &p, const char* filename, const float view[16]);
+bool load_state(plant &p, const char* filename, float view[16]);
+bool inspectNode(const stored_state *states, const float *time,
+                 const float *factor, int count, int node, nodeInfo &info);
@@ -0,0 +1,155 @@
+/******************************************************************************
+ *    File : growth.cpp
+ * Descrip : Implementation file for growth function evaluation. The batch
+ *           kernel is written as straight loops over arrays so that the
+ *           compiler can vectorize them.
+ *****************************************************************************/
+
+/* Include files */
+#include "params.h"
+#include "growth.h"
+#include <math.h>                       /* Need math functions */
+#include <stdint.h>
+#include <string.h>                     /* String operations */
+
+/* Constants */
+#define LN2 0.69314718f                 /* Natural log of 2 */
+#define LOG2E 1.44269504f               /* Base 2 log of e */
+#define SQRT2 1.41421356f               /* Square root of 2 */
+#define ROUND_MAGIC 12582912.0f         /* 1.5*2^23, rounds float to int */
+#define LOG_TABLE_BITS 7                /* Mantissa bits indexing log table */
+#define LOG_TABLE_SIZE (1 << LOG_TABLE_BITS)
+#define SIG_TABLE_SIZE 1024             /* Entries in sigmoid table */
+#define SIG_TABLE_MIN -9.0f             /* Sigmoid is ~0 below this time */
+#define SIG_TABLE_MAX 15.0f             /* Sigmoid is ~1 above this time */
+
+/* Lookup tables, filled on first use */
+static float log_table[LOG_TABLE_SIZE + 1];
+static float sig_table[SIG_TABLE_SIZE + 1];
+
+/* Growth function for the each component */
+float growth(float mytime)
+{
+#if SIGMOID_GROWTH == 1
+    return 1/(1 + exp(3-mytime));
+#else
+    return fmax(log(mytime*4)/4, 0.0);
+#endif
+}
+
+/* Reinterpret float bits as integer and back */
+static inline uint32_t floatBits(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static inline float bitsFloat(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/* Fill lookup tables */
+static bool initTables()
+{
+    for (int i=0; i<=LOG_TABLE_SIZE; i++)
+        log_table[i] = log(1 + (double)i/LOG_TABLE_SIZE);
+    for (int i=0; i<=SIG_TABLE_SIZE; i++)
+        sig_table[i] = growth(SIG_TABLE_MIN +
+                              i*(SIG_TABLE_MAX-SIG_TABLE_MIN)/SIG_TABLE_SIZE);
+    return true;
+}
+
+/* Polynomial approximation, about 1e-7 error for log and 1e-6 for sigmoid */
+static void growthPoly(const float * __restrict mytime,
+                       float * __restrict factor, int n)
+{
+    for (int i=0; i<n; i++)
+    {
+#if SIGMOID_GROWTH == 1
+        /* exp(x) = 2^k * 2^f where k is an integer and |f| <= 0.5 */
+        float x = fmin(fmax(3 - mytime[i], -80.0f), 80.0f) * LOG2E;
+        float k = (x + ROUND_MAGIC) - ROUND_MAGIC;
+        float f = (x - k) * LN2;
+        float p = 1 + f*(1 + f*(1/2.0f + f*(1/6.0f + f*(1/24.0f +
+                  f*(1/120.0f + f*(1/720.0f))))));
+        p *= bitsFloat((uint32_t)((int32_t)k + 127) << 23);
+        factor[i] = 1/(1 + p);
+#else
+        /* fmax(log(x), 0) == log(fmax(x, 1)); split x into 2^e * m */
+        uint32_t bits = floatBits(fmax(mytime[i]*4, 1.0f));
+        int32_t e = (int32_t)(bits >> 23) - 127;
+        float m = bitsFloat((bits & 0x007fffff) | 0x3f800000);
+        int32_t big = m > SQRT2;
+        m = big ? m*0.5f : m;
+        e += big;
+
+        /* log(m) = 2*atanh(s) for s = (m-1)/(m+1), |s| < 0.172 */
+        float s = (m - 1)/(m + 1);
+        float s2 = s*s;
+        float lm = 2*s*(1 + s2*(1/3.0f + s2*(1/5.0f + s2*(1/7.0f))));
+        factor[i] = (e*LN2 + lm)/4;
+#endif
+    }
+}
+
+/* Table lookup with linear interpolation, about 1e-5 error */
+static void growthTable(const float * __restrict mytime,
+                        float * __restrict factor, int n)
+{
+    static bool ready = initTables();
+    (void)ready;
+
+    for (int i=0; i<n; i++)
+    {
+#if SIGMOID_GROWTH == 1
+        float x = (mytime[i] - SIG_TABLE_MIN) *
+                  (SIG_TABLE_SIZE/(SIG_TABLE_MAX - SIG_TABLE_MIN));
+        x = fmin(fmax(x, 0.0f), SIG_TABLE_SIZE - 0.001f);
+        int32_t j = (int32_t)x;
+        float f = x - j;
+        factor[i] = sig_table[j] + f*(sig_table[j+1] - sig_table[j]);
+#else
+        /* Top mantissa bits index the table, the rest interpolate */
+        uint32_t bits = floatBits(fmax(mytime[i]*4, 1.0f));
+        int32_t e = (int32_t)(bits >> 23) - 127;
+        uint32_t j = (bits >> (23 - LOG_TABLE_BITS)) & (LOG_TABLE_SIZE - 1);
+        float f = (bits & ((1 << (23 - LOG_TABLE_BITS)) - 1)) *
+                  (1.0f/(1 << (23 - LOG_TABLE_BITS)));
+        float lm = log_table[j] + f*(log_table[j+1] - log_table[j]);
+        factor[i] = (e*LN2 + lm)/4;
+#endif
+    }
+}
+
+/* Evaluate growth factor, and color if requested, for n nodes at once */
+void growthBatch(const float *mytime, float *factor, float *color, int n,
+                 int accuracy)
+{
+    switch (accuracy)
+    {
+        case GROWTH_EXACT:
+            for (int i=0; i<n; i++)
+                factor[i] = growth(mytime[i]);
+            break;
+        case GROWTH_TABLE:
+            growthTable(mytime, factor, n);
+            break;
+        default:
+            growthPoly(mytime, factor, n);
+            break;
+    }
+    if (color == NULL)
+        return;
+
+    /* Interpolate from tip color, 3 floats per node for glColor3fv */
+    for (int i=0; i<n; i++)
+    {
+        color[3*i] = color_tip[0] + factor[i]*color_diff[0];
+        color[3*i+1] = color_tip[1] + factor[i]*color_diff[1];
+        color[3*i+2] = color_tip[2] + factor[i]*color_diff[2];
+    }
+}
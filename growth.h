@@ -0,0 +1,16 @@
+/******************************************************************************
+ *    File : growth.h
+ * Descrip : Header file for growth function evaluation
+ *****************************************************************************/
+
+#pragma once
+
+/* Accuracy modes for growth evaluation, see GROWTH_ACCURACY */
+#define GROWTH_EXACT 0                  /* Use libm log or exp */
+#define GROWTH_POLY 1                   /* Polynomial approximation */
+#define GROWTH_TABLE 2                  /* Interpolated lookup table */
+
+/* Procedure prototypes */
+float growth(float mytime);
+void growthBatch(const float *mytime, float *factor, float *color, int n,
+                 int accuracy);
@@ -0,0 +1,72 @@
+/******************************************************************************
+ *    File : matrix.cpp
+ * Descrip : Implementation file for 4x4 matrix operations
+ *****************************************************************************/
+
+/* Include files */
+#include "matrix.h"
+#include <math.h>                       /* Need math functions */
+#include <string.h>                     /* String operations */
+
+/* Set matrix to identity */
+void matIdentity(float m[16])
+{
+    memset(m, 0, 16*sizeof(float));
+    m[0] = m[5] = m[10] = m[15] = 1;
+}
+
+/* Replace columns a and b with their rotation by deg. Only two columns of
+   the matrix change when rotating about a principal axis. */
+static inline void rotateColumns(float m[16], int a, int b, float deg)
+{
+    float c = cos(deg*M_PI/180);
+    float s = sin(deg*M_PI/180);
+    for (int i=0; i<4; i++)
+    {
+        float ca = m[4*a+i];
+        float cb = m[4*b+i];
+        m[4*a+i] = c*ca + s*cb;
+        m[4*b+i] = c*cb - s*ca;
+    }
+}
+
+/* Same as glRotatef(deg, 1,0,0) */
+void matRotateX(float m[16], float deg)
+{
+    rotateColumns(m, 1, 2, deg);
+}
+
+/* Same as glRotatef(deg, 0,1,0) */
+void matRotateY(float m[16], float deg)
+{
+    rotateColumns(m, 2, 0, deg);
+}
+
+/* Same as glRotatef(deg, 0,0,1) */
+void matRotateZ(float m[16], float deg)
+{
+    rotateColumns(m, 0, 1, deg);
+}
+
+/* Same as glTranslatef(x, y, z) */
+void matTranslate(float m[16], float x, float y, float z)
+{
+    for (int i=0; i<4; i++)
+        m[12+i] += m[i]*x + m[4+i]*y + m[8+i]*z;
+}
+
+/* out = a * b, out may not alias a or b */
+void matMultiply(float out[16], const float a[16], const float b[16])
+{
+    for (int col=0; col<4; col++)
+        for (int row=0; row<4; row++)
+            out[4*col+row] = a[row]*b[4*col] + a[4+row]*b[4*col+1] +
+                             a[8+row]*b[4*col+2] + a[12+row]*b[4*col+3];
+}
+
+/* Transform point p by m */
+void matPoint(const float m[16], const float p[3], float out[3])
+{
+    for (int i=0; i<3; i++)
+        out[i] = m[i]*p[0] + m[4+i]*p[1] + m[8+i]*p[2] + m[12+i];
+}
@@ -0,0 +1,17 @@
+/******************************************************************************
+ *    File : matrix.h
+ * Descrip : Header file for 4x4 matrix operations. Matrices are stored in
+ *           column major order like OpenGL, and operations multiply on the
+ *           right like glRotatef and glTranslatef do.
+ *****************************************************************************/
+
+#pragma once
+
+/* Procedure prototypes */
+void matIdentity(float m[16]);
+void matRotateX(float m[16], float deg);
+void matRotateY(float m[16], float deg);
+void matRotateZ(float m[16], float deg);
+void matTranslate(float m[16], float x, float y, float z);
+void matMultiply(float out[16], const float a[16], const float b[16]);
+void matPoint(const float m[16], const float p[3], float out[3]);
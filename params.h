@@ -0,0 +1,69 @@
+/******************************************************************************
+ *    File : params.h
+ * Descrip : Plant parameters and types shared by all modules
+ *****************************************************************************/
+
+#pragma once
+
+/* Constants */
+#define INIT_SIZE 0.4                   /* Initial size of plant */
+#define TIME_INCR 0.00005f              /* Growth rate */
+#ifndef TREE_DEPTH
+#define TREE_DEPTH 1                    /* Levels of branches, 1 is twigs */
+#endif
+#define LEAF_BRANCHING 0                /* Set to 1 to let leaves branch */
+#define SIGMOID_GROWTH 0                /* Set to 1 to use Sigmoidal growth */
+#define GROWTH_ACCURACY 0               /* 0 exact, 1 polynomial, 2 table */
+#define STOCASTIC_PLANT 0               /* Set to 1 to make stocastic plant */
+#define DAG_INSTANCING 0                /* Set to 1 to share identical
+                                           subtrees of non-stocastic plant */
+#ifndef ENVIRONMENT
+#define ENVIRONMENT 0                   /* Set to 1 to slow growth of shaded
+                                           and crowded nodes */
+#endif
+#ifndef STATE_SIZE
+#define STATE_SIZE 10000                /* Max size of state tree */
+#endif
+#ifndef STATE_ENCODING
+#define STATE_ENCODING 0                /* 0 plain, 1 compact, 2 compact with
+                                           32 bit links, see compact.h. The
+                                           compact ones save memory but take
+                                           longer to decode, see make bench */
+#endif
+#define CONE_APPROX 3                   /* Higher values approx cone better */
+#define RAND_DIST uniform               /* Set to "uniform" or "guassian" */
+#define GREEN 0, 1, 0                   /* Green color */
+#define GREEN_LEAVES 0                  /* Are leaves green or grow color? */
+
+/* Tree parameters, defaults of each plant's species */
+#define AZIM_SPIN 5                     /* Azimuth spin per apex node */
+#define TURN_SPIN 0                     /* Turning of branch per apex node */
+#define BRANCH_PER_APEX 2               /* Number of leaves per apex node */
+#define LEAF_OUTWARD_ANGLE 38           /* Angle leaf makes with apex */
+#define LEAF_TO_TWIG_RATIO 50           /* Leaf is half the size of twig */
+#define BIG_AZIM_SPIN 55                /* Azimuth spin per apex node */
+#define BIG_TURN_SPIN 0                 /* Turning of branch per apex node */
+#define BIG_BRANCH_PER_APEX 2           /* Number of leaves per apex node */
+#define BIG_LEAF_OUTWARD_ANGLE 65       /* Angle leaf makes with apex */
+
+/* Starting position is different based on different renderers */
+#define STARTX 0                        /* right */
+#define STARTY 5                        /* depth */
+#define STARTZ -5                       /* height */
+
+/* Colors */
+const float color_tip[] = {GREEN};
+const float color_diff[] = {0.6, -0.7, 0};
+
+/* Types */
+typedef struct state {
+    float size;
+    float deg;
+    float azimuth;
+    float mytime;
+    int rule;
+    int child, sibling;
+} state;
+
+/* Same as NULL for state tree */
+#define NONE -1
@@ -0,0 +1,403 @@
+/******************************************************************************
+ *    File : pick.cpp
+ * Descrip : Implementation file for picking. Cones move in the snapshot
+ *           as the plant grows, so the hierarchy holds each cone by its
+ *           state and which of that state's cones it is, found through the
+ *           index of cones by state each snapshot carries. Each new
+ *           snapshot refits
+ *           the boxes bottom up; cones made since the last build are tested
+ *           one by one until there are enough of them, or the boxes have
+ *           loosened enough, to build again.
+ *****************************************************************************/
+
+/* Include files */
+#include "pick.h"
+#include <math.h>                       /* Need math functions */
+#include <algorithm>
+
+/* Types */
+typedef struct buildRef {
+    float center[3];                    /* Center of bounds of cone */
+    bvhPrim prim;                       /* Cone */
+} buildRef;
+
+/* Empty a box */
+static void boxClear(float lo[3], float hi[3])
+{
+    for (int i=0; i<3; i++)
+    {
+        lo[i] = INFINITY;
+        hi[i] = -INFINITY;
+    }
+}
+
+/* Grow box to hold another */
+static void boxAdd(float lo[3], float hi[3], const float olo[3],
+                   const float ohi[3])
+{
+    for (int i=0; i<3; i++)
+    {
+        lo[i] = fminf(lo[i], olo[i]);
+        hi[i] = fmaxf(hi[i], ohi[i]);
+    }
+}
+
+/* Half the surface area of box, 0 if empty */
+static float boxArea(const float lo[3], const float hi[3])
+{
+    float d[3];
+    for (int i=0; i<3; i++)
+    {
+        d[i] = hi[i] - lo[i];
+        if (!(d[i] >= 0))
+            return 0;
+    }
+    return d[0]*d[1] + d[1]*d[2] + d[2]*d[0];
+}
+
+/* Bounds of a cone, its two end circles padded along each axis by the
+   radius times how far the circle reaches along that axis. A little more
+   is added so rounding in coneEntry can't hit just outside. */
+static void coneBounds(const cone &c, float lo[3], float hi[3])
+{
+    float pad = BVH_PAD*(fmaxf(c.rad, c.rad2) + c.height);
+    for (int i=0; i<3; i++)
+    {
+        float axis = c.mat[8+i];
+        float reach = sqrtf(fmaxf(0, 1 - axis*axis));
+        float a = c.mat[12+i];
+        float b = a + axis*c.height;
+        lo[i] = fminf(a - c.rad*reach, b - c.rad2*reach) - pad;
+        hi[i] = fmaxf(a + c.rad*reach, b + c.rad2*reach) + pad;
+    }
+}
+
+/* Index in snapshot of cone of primitive, NONE if it has gone */
+static inline int primCone(const snapshot &snap, const bvhPrim &prim)
+{
+    return stateCone(snap, prim.node, prim.k);
+}
+
+/* Refit every box to the cones of snapshot, children before parents.
+   Returns summed area of boxes over area of root. */
+static float refit(bvh &b, const snapshot &snap)
+{
+    float area = 0;
+    for (int n=b.nodes.size()-1; n>=0; n--)
+    {
+        bvhNode &node = b.nodes[n];
+        boxClear(node.lo, node.hi);
+        if (node.count == 0)
+        {
+            for (int k=0; k<2; k++)
+                boxAdd(node.lo, node.hi, b.nodes[node.first+k].lo,
+                       b.nodes[node.first+k].hi);
+        }
+        else
+            for (int i=node.first; i<node.first+node.count; i++)
+            {
+                int c = primCone(snap, b.prims[i]);
+                if (c == NONE)
+                    continue;
+                float lo[3], hi[3];
+                coneBounds(snap.cones[c], lo, hi);
+                boxAdd(node.lo, node.hi, lo, hi);
+            }
+        area += boxArea(node.lo, node.hi);
+    }
+    float root = b.nodes.empty() ? 0 : boxArea(b.nodes[0].lo, b.nodes[0].hi);
+    return root > 0 ? area/root : 0;
+}
+
+/* Build hierarchy over every cone, splitting at the median of the longest
+   axis of the centers */
+static void build(bvh &b, const snapshot &snap)
+{
+    int states = snapshotStates(snap);
+    std::vector<buildRef> refs;
+    refs.reserve(snap.order.size());
+    b.known.assign(states, 0);
+    for (int n=0; n<states; n++)
+        for (int k=0; k<snap.first[n+1]-snap.first[n]; k++)
+        {
+            buildRef r;
+            float lo[3], hi[3];
+            r.prim.node = n;
+            r.prim.k = k;
+            coneBounds(snap.cones[primCone(snap, r.prim)], lo, hi);
+            for (int i=0; i<3; i++)
+                r.center[i] = 0.5*(lo[i] + hi[i]);
+            refs.push_back(r);
+            b.known[n]++;
+        }
+    b.nodes.clear();
+    b.nodes.reserve(2*refs.size()/BVH_LEAF + 1);
+    b.extra.clear();
+    b.epoch = snap.epoch;
+    b.wall = snap.wall;
+    b.builds++;
+
+    std::vector<int> todo;
+    if (!refs.empty())
+    {
+        b.nodes.push_back(bvhNode());
+        b.nodes[0].first = 0;
+        b.nodes[0].count = refs.size();
+        todo.push_back(0);
+    }
+    while (!todo.empty())
+    {
+        int n = todo.back();
+        todo.pop_back();
+        int first = b.nodes[n].first;
+        int count = b.nodes[n].count;
+        if (count <= BVH_LEAF)
+            continue;
+
+        float lo[3], hi[3];
+        boxClear(lo, hi);
+        for (int i=first; i<first+count; i++)
+            boxAdd(lo, hi, refs[i].center, refs[i].center);
+        int axis = 0;
+        for (int i=1; i<3; i++)
+            if (hi[i] - lo[i] > hi[axis] - lo[axis])
+                axis = i;
+        int half = count/2;
+        std::nth_element(refs.begin() + first, refs.begin() + first + half,
+                         refs.begin() + first + count,
+                         [axis](const buildRef &p, const buildRef &q) {
+                             return p.center[axis] < q.center[axis];
+                         });
+
+        int left = b.nodes.size();
+        b.nodes.resize(left + 2);
+        b.nodes[left].first = first;
+        b.nodes[left].count = half;
+        b.nodes[left+1].first = first + half;
+        b.nodes[left+1].count = count - half;
+        b.nodes[n].first = left;
+        b.nodes[n].count = 0;
+        todo.push_back(left);
+        todo.push_back(left+1);
+    }
+    b.prims.resize(refs.size());
+    for (int i=0; i<(int)refs.size(); i++)
+        b.prims[i] = refs[i].prim;
+    b.cost = refit(b, snap);
+}
+
+/* Start with an empty hierarchy */
+void bvhInit(bvh &b)
+{
+    b.nodes.clear();
+    b.prims.clear();
+    b.extra.clear();
+    b.known.clear();
+    b.epoch = -1;
+    b.wall = -1;
+    b.cost = 0;
+    b.builds = 0;
+}
+
+/* Follow snapshot, refitting if it is new and building again if the
+   state tree was reloaded or the hierarchy has fallen too far behind */
+void bvhUpdate(bvh &b, const snapshot &snap)
+{
+    int states = snapshotStates(snap);
+    if (snap.epoch == b.epoch && snap.wall == b.wall)
+        return;
+    bool rebuild = snap.epoch != b.epoch || states < (int)b.known.size();
+    if (!rebuild)
+    {
+        b.known.resize(states, 0);
+        for (int n=0; n<states; n++)
+            for (; b.known[n] < snap.first[n+1]-snap.first[n]; b.known[n]++)
+            {
+                bvhPrim prim = {n, b.known[n]};
+                b.extra.push_back(prim);
+            }
+        rebuild = (int)b.extra.size() > BVH_EXTRA + (int)b.prims.size()/8;
+    }
+    if (rebuild || refit(b, snap) > BVH_LOOSEN*b.cost)
+    {
+        build(b, snap);
+        return;
+    }
+    b.wall = snap.wall;
+}
+
+/* Distance along ray to where it enters box, INFINITY if it misses or
+   enters beyond far */
+static inline float boxEntry(const bvhNode &node, const float origin[3],
+                             const float inv[3], float far)
+{
+    float enter = 0, leave = far;
+    for (int i=0; i<3; i++)
+    {
+        float t0 = (node.lo[i] - origin[i])*inv[i];
+        float t1 = (node.hi[i] - origin[i])*inv[i];
+        enter = fmaxf(enter, fminf(t0, t1));
+        leave = fminf(leave, fmaxf(t0, t1));
+    }
+    return enter <= leave ? enter : INFINITY;
+}
+
+/* Distance along ray to the side of a cone, INFINITY if it misses. The
+   ray is moved into the frame of the cone, which has no scale, where the
+   side is x*x + y*y = (rad + slope*z)^2 for z from 0 to height. */
+static float coneEntry(const cone &c, const float origin[3],
+                       const float dir[3])
+{
+    if (c.height <= 0)
+        return INFINITY;
+    float p[3], o[3], d[3];
+    for (int i=0; i<3; i++)
+        p[i] = origin[i] - c.mat[12+i];
+    for (int i=0; i<3; i++)
+    {
+        const float *axis = &c.mat[4*i];
+        o[i] = axis[0]*p[0] + axis[1]*p[1] + axis[2]*p[2];
+        d[i] = axis[0]*dir[0] + axis[1]*dir[1] + axis[2]*dir[2];
+    }
+    /* Start the ray beside the cone, as from far away the quadratic below
+       loses to rounding what little the cone adds */
+    float shift = -(o[0]*d[0] + o[1]*d[1] + o[2]*d[2]);
+    for (int i=0; i<3; i++)
+        o[i] += shift*d[i];
+    float slope = (c.rad2 - c.rad)/c.height;
+    float r = c.rad + slope*o[2];
+    float dr = slope*d[2];
+    float a = d[0]*d[0] + d[1]*d[1] - dr*dr;
+    float b = 2*(o[0]*d[0] + o[1]*d[1] - r*dr);
+    float k = o[0]*o[0] + o[1]*o[1] - r*r;
+
+    float t[2];
+    int roots = 0;
+    if (fabsf(a) < 1e-12f)
+    {
+        if (b != 0)
+            t[roots++] = -k/b;
+    }
+    else
+    {
+        float disc = b*b - 4*a*k;
+        if (disc < 0)
+            return INFINITY;
+        float q = -0.5f*(b + copysignf(sqrtf(disc), b));
+        t[roots++] = q/a;
+        if (q != 0)
+            t[roots++] = k/q;
+        if (roots == 2 && t[1] < t[0])
+            std::swap(t[0], t[1]);
+    }
+    /* A newborn cone is so short its slope is huge, and rounding in z can
+       put a hit far off the cone, so check the hit is within its radius */
+    float widest = fmaxf(c.rad, c.rad2);
+    for (int i=0; i<roots; i++)
+    {
+        float x = o[0] + t[i]*d[0];
+        float y = o[1] + t[i]*d[1];
+        float z = o[2] + t[i]*d[2];
+        if (t[i] + shift > 0 && z >= 0 && z <= c.height &&
+            c.rad + slope*z >= 0 && x*x + y*y <= 1.001f*widest*widest)
+            return t[i] + shift;
+    }
+    return INFINITY;
+}
+
+/* Test ray against cone of primitive, keeping the nearest hit */
+static inline void testPrim(const bvh &b, const snapshot &snap,
+                            const bvhPrim &prim, const float origin[3],
+                            const float dir[3], pickHit &hit)
+{
+    int c = primCone(snap, prim);
+    if (c == NONE)
+        return;
+    float t = coneEntry(snap.cones[c], origin, dir);
+    if (t < hit.t)
+    {
+        hit.t = t;
+        hit.node = prim.node;
+        hit.cone = c;
+    }
+}
+
+/* Nearest cone along a ray, dir of unit length, in the snapshot last
+   passed to bvhUpdate. Children are visited nearest first, so most far
+   boxes are skipped once something is hit. */
+bool bvhPick(const bvh &b, const snapshot &snap, const float origin[3],
+             const float dir[3], pickHit &hit)
+{
+    float inv[3];
+    for (int i=0; i<3; i++)
+        inv[i] = 1/dir[i];
+    hit.node = NONE;
+    hit.cone = NONE;
+    hit.t = INFINITY;
+
+    int stack[BVH_STACK];               /* Nodes still to visit */
+    float entry[BVH_STACK];             /* Where ray enters each */
+    int depth = 0;
+    if (!b.nodes.empty())
+    {
+        stack[0] = 0;
+        entry[0] = boxEntry(b.nodes[0], origin, inv, INFINITY);
+        depth = 1;
+    }
+    while (depth > 0)
+    {
+        depth--;
+        if (entry[depth] >= hit.t)
+            continue;                   /* Something nearer was hit since */
+        const bvhNode &node = b.nodes[stack[depth]];
+        if (node.count > 0)
+        {
+            for (int i=node.first; i<node.first+node.count; i++)
+                testPrim(b, snap, b.prims[i], origin, dir, hit);
+            continue;
+        }
+        int near = node.first, far = node.first+1;
+        float tnear = boxEntry(b.nodes[near], origin, inv, hit.t);
+        float tfar = boxEntry(b.nodes[far], origin, inv, hit.t);
+        if (tfar < tnear)
+        {
+            std::swap(near, far);
+            std::swap(tnear, tfar);
+        }
+        if (tfar < INFINITY)
+        {
+            stack[depth] = far;
+            entry[depth++] = tfar;
+        }
+        if (tnear < INFINITY)
+        {
+            stack[depth] = near;
+            entry[depth++] = tnear;
+        }
+    }
+    for (int i=0; i<(int)b.extra.size(); i++)
+        testPrim(b, snap, b.extra[i], origin, dir, hit);
+    return hit.node != NONE;
+}
+
+/* Ray in world through the center of pixel x, y of a window, y down, seen
+   through frustum f from view, a world to eye transform with no scale */
+void pickRay(const float view[16], const frustum &f, int width, int height,
+             int x, int y, float origin[3], float dir[3])
+{
+    float eye[3] = {f.left + (x + 0.5f)*(f.right - f.left)/width,
+                    f.top - (y + 0.5f)*(f.top - f.bottom)/height,
+                    -f.znear};
+    float len = 0;
+    for (int i=0; i<3; i++)
+    {
+        const float *axis = &view[4*i];
+        origin[i] = -(axis[0]*view[12] + axis[1]*view[13] +
+                      axis[2]*view[14]);
+        dir[i] = axis[0]*eye[0] + axis[1]*eye[1] + axis[2]*eye[2];
+        len += dir[i]*dir[i];
+    }
+    len = sqrtf(len);
+    for (int i=0; i<3; i++)
+        dir[i] /= len;
+}
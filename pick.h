@@ -0,0 +1,60 @@
+/******************************************************************************
+ *    File : pick.h
+ * Descrip : Header file for picking. Rays from the mouse are cast on the CPU
+ *           against a bounding volume hierarchy over the cones of a snapshot.
+ *****************************************************************************/
+
+#pragma once
+
+#include "sim.h"
+#include "raster.h"
+#include <vector>
+
+/* Constants */
+#define BVH_LEAF 4                      /* Most primitives in a leaf */
+#define BVH_STACK 64                    /* Deepest traversal, tree is balanced */
+#define BVH_EXTRA 256                   /* New cones tested one by one before
+                                           rebuilding, plus 1/8 of the tree */
+#define BVH_PAD 0.01                    /* Padding of cone bounds by size */
+#define BVH_LOOSEN 2                    /* Rebuild once refitted boxes cost
+                                           this much more than when built */
+
+/* Types */
+typedef struct bvhNode {
+    float lo[3], hi[3];                 /* Bounding box */
+    int first;                          /* First primitive, or left child */
+    int count;                          /* Primitives in leaf, 0 if inner */
+} bvhNode;
+
+/* A cone is known by its state and which of the cones of that state it
+   is, since cones move in the snapshot as the plant grows */
+typedef struct bvhPrim {
+    int node;                           /* State cone came from */
+    int k;                              /* Which cone of the state */
+} bvhPrim;
+
+typedef struct bvh {
+    std::vector<bvhNode> nodes;         /* Root first, children after parent */
+    std::vector<bvhPrim> prims;         /* Primitives, by leaf */
+    std::vector<bvhPrim> extra;         /* Cones not in tree, tested alone */
+    std::vector<int> known;             /* Cones of each state in prims or
+                                           extra */
+    int epoch;                          /* Epoch of snapshot built from */
+    double wall;                        /* Snapshot last refitted to */
+    float cost;                         /* Box area over root area at build */
+    int builds;                         /* Times built */
+} bvh;
+
+typedef struct pickHit {
+    int node;                           /* State hit, NONE if nothing */
+    int cone;                           /* Cone hit in snapshot */
+    float t;                            /* Distance along ray */
+} pickHit;
+
+/* Procedure prototypes */
+void bvhInit(bvh &b);
+void bvhUpdate(bvh &b, const snapshot &snap);
+bool bvhPick(const bvh &b, const snapshot &snap, const float origin[3],
+             const float dir[3], pickHit &hit);
+void pickRay(const float view[16], const frustum &f, int width, int height,
+             int x, int y, float origin[3], float dir[3]);
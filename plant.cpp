@@ -11,10 +11,10 @@
     #include <GL/glut.h>
 #endif
 #include <math.h>                       /* Need math functions */
-#include <random>                       /* For guassian random function */
 #include <stdio.h>                      /* For file operations */
 #include <string.h>                     /* String operations */
 #include <stdlib.h>
+#include <unistd.h>                     /* For usleep */
 
 void initLighting()
 {
@@ -57,92 +57,7 @@ void capture()
     writeBMP(filename, winx, winy, buffer);
 }
 
-/* Save state tree */
-void save_state(const char* filename)
-{
-    std::ofstream out(filename, std::ios::out|std::ios::binary);
-    out.write((char *)&curview, sizeof(curview)); /* write view matrix */
-    out.write((char *)&time_cur, sizeof(time_cur)); /* write cur time */
-    out.write((char *)&nextFree, sizeof(nextFree)); /* write size of state tree */
-    out.write((char *)&states, sizeof(state)*nextFree); /* write state tree */
-}
-
-/* Load state tree */
-void load_state(const char* filename)
-{
-    std::ifstream in(filename, std::ios::in|std::ios::binary);
-    in.read((char *)&start, sizeof(start)); /* read view matrix */
-    in.read((char *)&time_cur, sizeof(time_cur)); /* read cur time */
-    in.read((char *)&nextFree, sizeof(nextFree)); /* read size of state tree */
-    in.read((char *)&states, sizeof(state)*nextFree); /* read state tree */
-    memcpy(curview, start, sizeof(start));
-}
-
-/* Growth function for the each component */
-float growth(float mytime)
-{
-#if SIGMOID_GROWTH == 1
-    return 1/(1 + exp(3-mytime));
-#else
-    return fmax(log(mytime*4)/4, 0.0);
-#endif
-}
-
-/* Function that returns a uniform random variable */
-float uniform(float mu, float sigma)
-{
-    return mu - sigma/2 + (rand() * sigma/RAND_MAX);
-}
-
-/* Use std library to return a guassian distribution random variable */
-float guassian(float m, float s)
-{
-    std::normal_distribution<double> distribution(m, s);
-    static std::default_random_engine generator;
-    return distribution(generator);
-}
-
-/* Retrieve state from state tree */
-inline int nextState(int &mystate, float &size, float &deg, float &azimuth,
-                      float &mytime)
-{
-    if (mystate != NONE)
-    {
-        size = states[mystate].size;
-        deg = states[mystate].deg;
-        azimuth = states[mystate].azimuth;
-        mytime += states[mystate].mytime;
-    }
-    else if (nextFree >= STATE_SIZE)
-        exit(1);
-    else {
-        mystate = ++nextFree;
-#if STOCASTIC_PLANT == 1
-        states[mystate].size = RAND_DIST(size, size/3);
-        states[mystate].deg = RAND_DIST(deg, 20);
-        states[mystate].azimuth = RAND_DIST(azimuth, 180);
-        states[mystate].mytime = RAND_DIST(-0.25, 0.5);
-        states[mystate].rule = (int)RAND_DIST(2.5, 2); /* 1,2,3 */
-
-        // Update passed parameters
-        size = states[mystate].size;
-        deg = states[mystate].deg;
-        azimuth = states[mystate].azimuth;
-        mytime = states[mystate].mytime;
-#else
-        states[mystate].size = size;
-        states[mystate].deg = deg;
-        states[mystate].azimuth = azimuth;
-        states[mystate].mytime = 0;
-        states[mystate].rule = 2;
-#endif
-        states[mystate].child = NONE;
-        states[mystate].sibling = NONE;
-    }
-    return states[mystate].rule;
-}
-
-void init()
+void init(unsigned int seed)
 {
     glClearColor(0.0, 0.0, 0.0, 0.0);
     //glClearColor(1.0, 1.0, 1.0, 0.0);
@@ -151,9 +66,8 @@ void init()
     initLighting();
 
     /* Set up initial state */
-    srand(time(0));                   /* use time as seed for randomization */
-    states[0].child = NONE;
-    states[0].sibling = NONE;
+    simSeed(seed);                    /* seed randomization, time unless
+                                         replaying a session */
 
     /* Anti-aliasing hints */
     glHint(GL_POLYGON_SMOOTH_HINT, GL_NICEST);
@@ -165,162 +79,201 @@ void init()
     glTranslatef(0.0, 0.0, -15.0);
     glGetFloatv(GL_MODELVIEW_MATRIX, curview);
     glGetFloatv(GL_MODELVIEW_MATRIX, start);
+
+    bvhInit(pick_bvh);
+    picked.node = NONE;
 }
 
-void drawLeaf(float mytime, float size_bot, float deg, float azimuth,
-              int &mystate)
+/* Draw snapshot, moving each cone alpha of the way from where it was in
+   the previous snapshot. A cone is matched by its state and which of that
+   state's cones it is. With instancing a state's cones come from shared
+   parts, whose order can change between steps, so nothing blends. */
+void drawSnapshot(const snapshot &cur, const snapshot &prev, float alpha)
 {
-    /* Base case */
-    if (size_bot <= 0 || mytime < 0)
-        return;
-
-    static float size;
-    static float factor;
-    static int rule;
-    size = INIT_SIZE*LEAF_TO_TWIG_RATIO;
-    rule = nextState(mystate, size, deg, azimuth, mytime);
-
-    factor = growth(mytime);
-    size *= factor;
-    deg *= factor;
-
-    if (rule == 2)
-    {
+    bool blend = !INSTANCING && alpha < 1 && prev.epoch == cur.epoch &&
+                 cur.rank.size() == cur.cones.size();
+    float mat[16];
+    float rad, rad2, height;
+    float color[3];
+
+    for (int i=0; i<(int)cur.cones.size(); i++) {
+        const cone &c = cur.cones[i];
+        int j = blend ? stateCone(prev, c.node, cur.rank[i]) : NONE;
+        if (j == NONE)
+        {
+            glPushMatrix();
+            glMultMatrixf(c.mat);
+            glColor3fv(c.color);
+            drawCone(c.rad, c.rad2, c.height, false, CONE_APPROX);
+            glPopMatrix();
+            continue;
+        }
+
+        /* Blend with previous cone */
+        const cone &o = prev.cones[j];
+        for (int k=0; k<16; k++)
+            mat[k] = o.mat[k] + alpha*(c.mat[k]-o.mat[k]);
+        for (int k=0; k<3; k++)
+            color[k] = o.color[k] + alpha*(c.color[k]-o.color[k]);
+        rad = o.rad + alpha*(c.rad-o.rad);
+        rad2 = o.rad2 + alpha*(c.rad2-o.rad2);
+        height = o.height + alpha*(c.height-o.height);
         glPushMatrix();
-        glRotatef(TURN_SPIN, 0,1,0);
-        glRotatef(azimuth, 0,0,1);
-        glRotatef(deg, 0,1,0);
-#if GREEN_LEAVES==1
-        glColor3f(GREEN);
-#else
-        glColor3f(color_tip[0]+factor*color_diff[0],
-                  color_tip[1]+factor*color_diff[1],
-                  color_tip[2]+factor*color_diff[2]);
-#endif
-        drawCone(size_bot, 0.02*size_bot, size*size_bot, false, CONE_APPROX);
+        glMultMatrixf(mat);
+        glColor3fv(color);
+        drawCone(rad, rad2, height, false, CONE_APPROX);
         glPopMatrix();
     }
-#if TREE_DEPTH == 20                    /* This case doesn't work */
-    else if (rule == 1)
-    {
-        glPushMatrix();
-        drawTwig(mytime-0.5, size_bot, size_bot, deg, azimuth,
-                 states[mystate].child);
-        glPopMatrix();
-    }        
-    else
+}
+
+/* Sink drawing cones as they are generated */
+void drawCones(const cone *cones, int n, void *data)
+{
+    int &count = *(int *)data;
+    for (int i=0; i<n; i++)
     {
         glPushMatrix();
-        drawBigTwig(mytime-0.5, size_bot, INIT_SIZE, deg, azimuth,
-                    states[mystate].child);
+        glMultMatrixf(cones[i].mat);
+        glColor3fv(cones[i].color);
+        drawCone(cones[i].rad, cones[i].rad2, cones[i].height, false,
+                 CONE_APPROX);
         glPopMatrix();
     }
-#endif
+    count += n;
 }
 
-void drawTwig(float mytime, float size_bot, float size, float deg,
-             float azimuth, int &mystate)
+/* Draw plants of forest around the camera, returns cones drawn */
+int drawForest()
 {
-    // Base case
-    if (mytime < 0)
-        return;
+    int count = 0;
+    coneSink to_gl = {drawCones, &count};
+    forestDraw(woods, to_gl);
+    return count;
+}
 
-    // Temporary vars are static to save stack space
-    static int rule;
-    static int spin;
-    static float size_top;
-    static float factor;
-    static state* sib_state;
-
-    rule = nextState(mystate, size, deg, azimuth, mytime)*BRANCH_PER_APEX;
-    if (rule > 0)
-        spin = 360/rule;
-    factor = growth(mytime-0.5);
-    size_top = INIT_SIZE * factor;
-    deg *= factor;
-
-    /* Render twig */
-    glColor3f(color_tip[0]+factor*color_diff[0],
-              color_tip[1]+factor*color_diff[1],
-              color_tip[2]+factor*color_diff[2]);
-    glRotatef(azimuth, 0,0,1);
-    glRotatef(deg, 0,1,0);
-    drawCone(size_bot, size_top, size_bot*10, false, CONE_APPROX);
-    glTranslatef(0, 0, size_bot*10);
-
-    /* Render sibling leaves */
-    sib_state = &states[mystate];
-    for (int i=0; i<rule; i++) {
-        drawLeaf(mytime, size_top, LEAF_OUTWARD_ANGLE, azimuth,
-                 sib_state->sibling);
-        sib_state = &states[sib_state->sibling];
-        azimuth += spin;
+/* Pick the node under the mouse in snapshot and look it up */
+void pickNode(const snapshot &snap)
+{
+    float origin[3], dir[3];
+    pick_pending = false;
+    pickRay(curview, windowFrustum(winx, winy), winx, winy, pick_x, pick_y,
+            origin, dir);
+    double pick_start = wallTime();
+    bvhPick(pick_bvh, snap, origin, dir, picked);
+    pick_time = wallTime() - pick_start;
+    if (picked.node == NONE || !simInspect(snap, picked.node, picked_info))
+    {
+        picked.node = NONE;
+        return;
     }
-
-    /* Undo rotational transformation */
-    glRotatef(-deg+TURN_SPIN, 0,1,0);
-    glRotatef(-azimuth+AZIM_SPIN, 0,0,1);
-
-    /* Recurse */
-    drawTwig(mytime-0.5, size_top, size, deg, azimuth,
-             states[mystate].child);
+    const nodeInfo &i = picked_info;
+    fprintf(stderr, "node %d: size %g deg %g azimuth %g mytime %g rule %d "
+            "child %d sibling %d time %g factor %g subtree %d depth %d "
+            "tips %d pick %.3f ms\n", picked.node, i.s.size, i.s.deg,
+            i.s.azimuth, i.s.mytime, i.s.rule, i.s.child, i.s.sibling,
+            i.time, i.factor, i.nodes, i.depth, i.tips, 1000*pick_time);
 }
 
-void drawBigTwig(float mytime, float size_bot, float size, float deg,
-                float azimuth, int &mystate)
+/* Draw cones of picked node in white over the plant, and what is known
+   about it in the corner */
+void drawPicked(const snapshot &snap)
 {
-    // Base case
-    if (mytime < 0)
+    if (picked.node == NONE)
         return;
-
-    // Temporary vars are static to save stack space
-    static int rule;
-    static float spin;
-    static float size_top;
-    static float factor;
-    static state* sib_state;
-
-    rule = nextState(mystate, size, deg, azimuth, mytime)*BIG_BRANCH_PER_APEX;
-    if (rule > 0)
-        spin = 360/rule;
-    factor = growth(mytime-0.5);
-    size_top = INIT_SIZE * factor;
-
-    /* Render twig */
-    glColor3f(color_tip[0]+factor*color_diff[0],
-              color_tip[1]+factor*color_diff[1],
-              color_tip[2]+factor*color_diff[2]);
-    glRotatef(azimuth, 0,0,1);
-    glRotatef(deg, 0,1,0);
-    drawCone(size_bot, size_top, size_bot*10, false, CONE_APPROX);
-    glTranslatef(0, 0, size_bot*10);
-
-    /* Render sibling leaves */
-    sib_state = &states[mystate];
-    for (int i=0; i<rule; i++) {
+    glDepthFunc(GL_LEQUAL);
+    glColor3f(1, 1, 1);
+    for (int i=0; i<(int)snap.cones.size(); i++)
+    {
+        const cone &c = snap.cones[i];
+        if (c.node != picked.node)
+            continue;
         glPushMatrix();
-        drawTwig(mytime, size_top, INIT_SIZE, BIG_LEAF_OUTWARD_ANGLE,
-                 azimuth, sib_state->sibling);
-        sib_state = &states[sib_state->sibling];
-        azimuth += spin;
+        glMultMatrixf(c.mat);
+        drawCone(c.rad, c.rad2, c.height, false, CONE_APPROX);
         glPopMatrix();
     }
-    glRotatef(-deg+BIG_TURN_SPIN, 0,1,0);
-    glRotatef(-azimuth+BIG_AZIM_SPIN, 0,0,1);
+    glDepthFunc(GL_LESS);
+
+    const nodeInfo &i = picked_info;
+    char lines[3][128];
+    snprintf(lines[0], sizeof(lines[0]), "node %d  size %.3f  deg %.1f  "
+             "azimuth %.1f  mytime %.2f  rule %d", picked.node, i.s.size,
+             i.s.deg, i.s.azimuth, i.s.mytime, i.s.rule);
+    snprintf(lines[1], sizeof(lines[1]), "growth time %.2f  factor %.2f  "
+             "child %d  sibling %d", i.time, i.factor, i.s.child, i.s.sibling);
+    snprintf(lines[2], sizeof(lines[2]), "subtree %d nodes  depth %d  "
+             "%d tips  picked in %.3f ms", i.nodes, i.depth, i.tips,
+             1000*pick_time);
+
+    glPushAttrib(GL_ENABLE_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, winx, 0, winy);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    for (int l=0; l<3; l++)
+    {
+        glRasterPos2i(8, winy - 18*(l+1));
+        for (const char *c=lines[l]; *c; c++)
+            glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *c);
+    }
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
 
-    /* Recurse */
-    drawBigTwig(mytime-0.5, size_top, size, deg,
-                azimuth, states[mystate].child);
+/* Draw one tile of a poster through sub-frustum f and read it back */
+void drawTile(const frustum &f, int width, int height, unsigned char *rgb,
+              void *data)
+{
+    const snapshot &snap = *(const snapshot *)data;
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glFrustum(f.left, f.right, f.bottom, f.top, f.znear, f.zfar);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadMatrixf(curview);
+    setLight();
+    if (forest_view)
+        drawForest();
+    else
+        drawSnapshot(snap, snap, 1);
+    glPopMatrix();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadBuffer(GL_BACK);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rgb);
+    glViewport(0, 0, winx, winy);
 }
 
 void display()
 {
-    static int root = 0;                /* Root of state tree */
+    const snapshot *cur, *prev;
+    double frame_start = wallTime();
 
     /* Quit gracefully */
     if (quit)
+    {
+        sessionStop();
+        simStop();
         exit(0);
-    
+    }
+
+    /* While recording or replaying, each frame takes one tick */
+    if (sessionMode() != SESSION_OFF)
+    {
+        replayInput();
+        simStep();
+    }
+    double sim_done = wallTime();
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     /* Move the image plane, keeping the frustum angle */
@@ -345,32 +298,65 @@ void display()
     setLight();                         /* Position lights after camera
                                            transformation */
 
-    /* Take one time step, but don't grow negative */
-    if (time_cur > 0 || time_step > 0)
-    	time_cur += time_step;
-
-    /* Render plant */
-    float size_bot = INIT_SIZE * growth(time_cur);
+    /* Render plant one tick behind simulation, blending between the two
+       newest snapshots */
+    simAcquire(cur, prev);
+    float alpha = 1;
+    if (sessionMode() == SESSION_OFF && cur->wall > prev->wall)
+        alpha = fmin((wallTime() - 1.0/SIM_RATE - prev->wall) /
+                     (cur->wall - prev->wall), 1);
+    blending = alpha < 1;
+    int cones = cur->cones.size();
+    if (forest_view)
+    {
+        /* Page in tiles around the camera and draw them */
+        forestUpdate(woods, curview);
+        cones = drawForest();
+    }
+    else
+        drawSnapshot(*cur, *prev, fmax(alpha, 0));
 
-    glRotatef(-90, 1,0,0);
-    glTranslatef(STARTX, STARTY, STARTZ);
-#if TREE_DEPTH==2
-    drawBigTwig(time_cur, size_bot, INIT_SIZE, 0, 0, root);
-#else
-    drawTwig(time_cur, size_bot, INIT_SIZE, 0, 0, root);
-#endif
+    /* Once picking is used, keep the hierarchy fitted to each snapshot so
+       a pick only has to cast the ray */
+    if (picking && !forest_view)
+    {
+        bvhUpdate(pick_bvh, *cur);
+        if (pick_pending)
+            pickNode(*cur);
+    }
 
     /* Are we rendering for a movie? */
     if (make_movie)
         capture();
 
+    if (picking && !forest_view)
+        drawPicked(*cur);
     glPopMatrix();
+    if (sessionMode() == SESSION_REPLAY)
+        glFinish();                     /* Time the drawing, not the swap */
+    if (sessionFrameDone(sim_done - frame_start, wallTime() - sim_done,
+                         cones))
+        quit = true;
+
+    /* Render a poster of this frame a window at a time. The last tile is
+       left in the back buffer, so draw the frame again instead of showing
+       it. */
+    if (make_poster)
+    {
+        make_poster = false;
+        renderPoster("poster.bmp", windowFrustum(winx, winy),
+                     POSTER_SCALE*winx, POSTER_SCALE*winy, POSTER_SAMPLES,
+                     winx, winy, drawTile, (void *)cur);
+        glutPostRedisplay();
+        return;
+    }
     glutSwapBuffers();
 }
 
 /* Function called when mouse is moved while one of the buttons is held down */
 void motion(int x, int y)
 {
+    sessionLog(SESSION_MOTION, x, y, 0, 0);
     if (!mouseDown)
         return;                         /* Middle button not down, do nada */
     if (xOldMouse != -1)
@@ -385,6 +371,7 @@ void motion(int x, int y)
 /* Reshape of window calls this function */
 void reshape(int w, int h)
 {
+    sessionLog(SESSION_RESHAPE, w, h, 0, 0);
     glMatrixMode(GL_PROJECTION);
     
     winx = w;
@@ -400,6 +387,7 @@ void reshape(int w, int h)
 /* When keyboard is used, this function is called */
 void keyboard(unsigned char key, int x, int y)
 {
+    sessionLog(SESSION_KEY, key, x, y, 0);
     xOldMouse = -1;                     /* Forget old mouse position */
 
     switch(key)
@@ -411,12 +399,15 @@ void keyboard(unsigned char key, int x, int y)
             break;
         case 'g':
             time_step += TIME_INCR;     /* speed up growth */
+            simSetStep(time_step);
             break;
         case 'G':
             time_step -= TIME_INCR;     /* slow growth */
+            simSetStep(time_step);
             break;
         case 'h':
             time_step = 0;              /* stop growth */
+            simSetStep(time_step);
             break;
         case '2':
         case 'b':
@@ -482,24 +473,57 @@ void keyboard(unsigned char key, int x, int y)
         case 'm':
             make_movie = !make_movie;
             break;
+        case 'P':
+            make_poster = true;
+            glutPostRedisplay();
+            break;
+        case 'i':
+            picking = true;             /* inspect node under mouse */
+            pick_pending = true;
+            pick_x = x;
+            pick_y = y;
+            glutPostRedisplay();
+            break;
         case 'S':
-            save_state("out.state");
+            simSave("out.state", curview);
             break;
         case 'L':
-            load_state("out.state");
+            if (!simLoad("out.state", start))
+            {
+                fprintf(stderr, "out.state: can't read state\n");
+                break;
+            }
+            memcpy(curview, start, sizeof(start));
             break;
         default:
             break;
     }
 }
 
+/* Redraw only if there is something new to show, otherwise sleep a tick.
+   A session draws a frame every tick, as fast as it can when replaying. */
 void idle()
 {
-    glutPostRedisplay();
+    if (sessionMode() != SESSION_OFF)
+    {
+        static double next = 0;
+        double now = wallTime();
+        if (sessionMode() == SESSION_RECORD && next > now)
+            usleep((next - now)*1000000);
+        next = fmax(next, now) + 1.0/SIM_RATE;
+        glutPostRedisplay();
+        return;
+    }
+    if (simFresh() || blending || make_movie ||
+        zpos != 0 || xspin != 0 || yspin != 0)
+        glutPostRedisplay();
+    else
+        usleep(1000000/SIM_RATE);
 }
 
 void mouse(int button, int state, int x, int y)
 {
+    sessionLog(SESSION_MOUSE, button, state, x, y);
     switch (button)
     {
         case GLUT_LEFT_BUTTON:
@@ -529,8 +553,42 @@ void mouse(int button, int state, int x, int y)
     }
 }
 
+/* Feed input recorded before this frame back through the callbacks */
+void replayInput()
+{
+    sessionEvent e;
+    while (sessionNext(e))
+    {
+        if (e.type == SESSION_KEY)
+            keyboard(e.arg[0], e.arg[1], e.arg[2]);
+        else if (e.type == SESSION_MOUSE)
+            mouse(e.arg[0], e.arg[1], e.arg[2], e.arg[3]);
+        else if (e.type == SESSION_MOTION)
+            motion(e.arg[0], e.arg[1]);
+        else if (e.type == SESSION_RESHAPE)
+        {
+            glutReshapeWindow(e.arg[0], e.arg[1]);
+            reshape(e.arg[0], e.arg[1]); /* Size this frame, not later */
+        }
+    }
+}
+
 int main(int argc, char** argv)
 {
+    /* Headless modes */
+    if (argc > 1 && strcmp(argv[1], "--farm") == 0)
+        return farmMain(argc-2, argv+2);
+    if (argc > 1 && strcmp(argv[1], "--worker") == 0)
+        return workerMain(argc-2, argv+2);
+    if (argc > 1 && strcmp(argv[1], "--poster") == 0)
+        return posterMain(argc-2, argv+2);
+    if (argc > 1 && strcmp(argv[1], "--serve") == 0)
+        return serviceMain(argc-2, argv+2);
+    if (argc > 1 && strcmp(argv[1], "--make-forest") == 0)
+        return forestMain(argc-2, argv+2);
+    if (argc > 1 && strcmp(argv[1], "--sweep") == 0)
+        return sweepMain(argc-2, argv+2);
+
 /*
     cerr << "The navigation controls are:" << endl;
     cerr << "  Forward:          f or 8 or left mouse click" << endl;
@@ -552,20 +610,71 @@ int main(int argc, char** argv)
     cerr << "  Quit:             q" << endl;
     */
 
+    /* Sessions, otherwise an optional state file */
+    sessionInfo info;
+    memset(&info, 0, sizeof(info));
+    info.seed = time(0);
+    info.width = winx;
+    info.height = winy;
+    if (argc > 2 && strcmp(argv[1], "--record") == 0)
+    {
+        if (argc > 3)
+            snprintf(info.state, sizeof(info.state), "%s", argv[3]);
+        if (!sessionRecord(argv[2], info))
+        {
+            fprintf(stderr, "%s: can't write session\n", argv[2]);
+            return 1;
+        }
+    }
+    else if (argc > 2 && strcmp(argv[1], "--replay") == 0)
+    {
+        if (!sessionReplay(argv[2], argc > 3 ? argv[3] : "timing.csv", info))
+        {
+            fprintf(stderr, "%s: can't read session\n", argv[2]);
+            return 1;
+        }
+        winx = info.width;
+        winy = info.height;
+    }
+    else if (argc > 2 && strcmp(argv[1], "--forest") == 0)
+    {
+        size_t budget = (argc > 3 ? atof(argv[3]) : FOREST_BUDGET)*FOREST_MB;
+        if (!forestOpen(woods, argv[2], budget))
+        {
+            fprintf(stderr, "%s: can't read forest\n", argv[2]);
+            return 1;
+        }
+        forest_view = true;
+    }
+    else if (argc > 1)
+        snprintf(info.state, sizeof(info.state), "%s", argv[1]);
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(winx, winy);
     glutInitWindowPosition(100, 100);
     glutIdleFunc(idle);
     glutCreateWindow(argv[0]);
-    init();
-    if (argc > 1)
-        load_state(argv[1]);
+    init(info.seed);
+    if (info.state[0])
+    {
+        if (!simLoad(info.state, start))
+        {
+            fprintf(stderr, "%s: can't read state\n", info.state);
+            return 1;
+        }
+        memcpy(curview, start, sizeof(start));
+    }
+    if (sessionMode() == SESSION_OFF && !forest_view)
+        simStart();
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
-    glutMouseFunc(mouse);
-    glutKeyboardFunc(keyboard);
-    glutMotionFunc(motion);             /* Called when mouse button down */
+    if (sessionMode() != SESSION_REPLAY)
+    {
+        glutMouseFunc(mouse);
+        glutKeyboardFunc(keyboard);
+        glutMotionFunc(motion);         /* Called when mouse button down */
+    }
     glutMainLoop();
     return(0);
 }
@@ -0,0 +1,185 @@
+/******************************************************************************
+ *    File : poster.cpp
+ * Descrip : Implementation file for poster rendering. The view frustum is
+ *           cut into sub-frusta, one per tile, each rendered samples times
+ *           larger than it appears and averaged down. Tiles are done a row
+ *           band at a time from the bottom and each is written straight to
+ *           its place in the bitmap, so only one tile is ever in memory.
+ *
+ *           Usage: plant-grow --poster <file> [options]
+ *           Options: --state <file> --seed <n> --time <t> --size <w> <h>
+ *                    --samples <n> --tile <pixels>
+ *****************************************************************************/
+
+/* Include files */
+#include "poster.h"
+#include "grow.h"
+#include "matrix.h"
+#include "bitmap.h"
+#include <algorithm>
+#include <stdio.h>                      /* For file operations */
+#include <stdlib.h>
+#include <string.h>                     /* String operations */
+#include <time.h>
+#include <vector>
+
+/* Constants */
+#define POSTER_FRAME 500                /* Window size poster is framed as */
+#define POSTER_STEP 0.05                /* Time step growing to poster time */
+
+/* Types */
+typedef struct coneScene {
+    std::vector<cone> cones;            /* Whole plant */
+    float view[16];                     /* World to eye transform */
+} coneScene;
+
+/* Render poster of width by height pixels seen through f into a bitmap.
+   render is called for tiles of tile_width by tile_height pixels, which it
+   must be able to draw, and each is averaged down samples times. */
+bool renderPoster(const char* filename, const frustum &f, int width,
+                  int height, int samples, int tile_width, int tile_height,
+                  tileRenderer render, void *data)
+{
+    int step_x = tile_width/samples;    /* Poster pixels per tile */
+    int step_y = tile_height/samples;
+    long stride = (3*width + 3) & ~3;   /* Bitmap rows are padded */
+    long header = 14 + sizeof(BMP_BITMAPINFOHEADER);
+    if (width < 1 || height < 1 || samples < 1 || step_x < 1 || step_y < 1 ||
+        header + stride*height > 0xffffffffL)
+    {
+        fprintf(stderr, "%s: bad poster size\n", filename);
+        return false;
+    }
+    FILE *out = fopen(filename, "wb");
+    if (out == NULL)
+    {
+        fprintf(stderr, "%s: can't write poster\n", filename);
+        return false;
+    }
+    writeBMPHeader(out, width, height);
+
+    int rw = step_x*samples, rh = step_y*samples;
+    std::vector<unsigned char> tile(3*rw*rh);
+    std::vector<unsigned char> row(3*step_x + 3, 0);
+    for (int y0=0; y0<height; y0+=step_y)
+        for (int x0=0; x0<width; x0+=step_x)
+        {
+            /* Frustum of the full tile, even where it hangs off the edge,
+               so every tile has the same pixel size */
+            frustum t = f;
+            t.left = f.left + (f.right - f.left)*x0/width;
+            t.right = f.left + (f.right - f.left)*(x0 + step_x)/width;
+            t.bottom = f.bottom + (f.top - f.bottom)*y0/height;
+            t.top = f.bottom + (f.top - f.bottom)*(y0 + step_y)/height;
+            render(t, rw, rh, &tile[0], data);
+
+            /* Average down each row, swap to BGR and pad the last tile */
+            int w = std::min(step_x, width - x0);
+            int h = std::min(step_y, height - y0);
+            int bytes = 3*w + (x0 + w == width ? stride - 3*width : 0);
+            for (int r=0; r<h; r++)
+            {
+                for (int x=0; x<w; x++)
+                    for (int c=0; c<3; c++)
+                    {
+                        int sum = 0;
+                        for (int j=0; j<samples; j++)
+                            for (int i=0; i<samples; i++)
+                                sum += tile[3*((r*samples + j)*rw +
+                                               x*samples + i) + c];
+                        row[3*x + 2-c] = (sum + samples*samples/2) /
+                                         (samples*samples);
+                    }
+                memset(&row[3*w], 0, bytes - 3*w);
+                fseek(out, header + (y0 + r)*stride + 3*x0, SEEK_SET);
+                fwrite(&row[0], bytes, 1, out);
+            }
+        }
+    bool ok = !ferror(out);
+    ok = fclose(out) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "%s: can't write poster\n", filename);
+    return ok;
+}
+
+/* Draw a tile of cones with the software renderer */
+static void rasterTile(const frustum &f, int width, int height,
+                       unsigned char *rgb, void *data)
+{
+    coneScene &scene = *(coneScene *)data;
+    renderCones(scene.cones, scene.view, f, width, height, rgb);
+}
+
+/* Render a poster of a plant without a window */
+int posterMain(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        fprintf(stderr, "usage: plant-grow --poster <file> [options]\n");
+        return 2;
+    }
+    const char *state = NULL;
+    unsigned int seed = time(0);
+    float time_to = -1;
+    int width = 4000, height = 4000;
+    int samples = 2;
+    int tile = 1024;
+    for (int i=1; i<argc; i++)
+    {
+        bool more = i+1 < argc;
+        if (strcmp(argv[i], "--state") == 0 && more)
+            state = argv[++i];
+        else if (strcmp(argv[i], "--seed") == 0 && more)
+            seed = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--time") == 0 && more)
+            time_to = atof(argv[++i]);
+        else if (strcmp(argv[i], "--size") == 0 && i+2 < argc)
+        {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--samples") == 0 && more)
+            samples = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--tile") == 0 && more)
+            tile = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (width < 1 || height < 1 || samples < 1 || tile < samples)
+    {
+        fprintf(stderr, "bad poster parameters\n");
+        return 2;
+    }
+
+    /* Grow plant to poster time in small steps, as it would grow on screen */
+    plant p;
+    coneScene scene;
+    coneSink skip = {NULL, NULL};
+    initPlant(p);
+    seedPlant(p, seed);
+    matIdentity(scene.view);
+    matTranslate(scene.view, 0.0, 0.0, -15.0);
+    if (state && !load_state(p, state, scene.view))
+    {
+        fprintf(stderr, "%s: can't read state\n", state);
+        return 1;
+    }
+    while (p.time_cur + POSTER_STEP < time_to)
+    {
+        p.time_cur += POSTER_STEP;
+        generate(p, skip);
+    }
+    if (time_to >= 0)
+        p.time_cur = time_to;
+    generate(p, scene.cones);
+
+    /* Frame the poster like the default window, stretched to its shape */
+    int big = std::max(width, height);
+    frustum f = windowFrustum(POSTER_FRAME*width/big,
+                              POSTER_FRAME*height/big);
+    return renderPoster(argv[0], f, width, height, samples, tile, tile,
+                        rasterTile, &scene) ? 0 : 1;
+}
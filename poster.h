@@ -0,0 +1,22 @@
+/******************************************************************************
+ *    File : poster.h
+ * Descrip : Header file for rendering stills bigger than any window, a tile
+ *           at a time, straight into a bitmap file
+ *****************************************************************************/
+
+#pragma once
+
+#include "raster.h"
+
+/* Types */
+
+/* Renders the part of the scene seen through f into rgb, width by height
+   pixels of 3 bytes, bottom row first like glReadPixels */
+typedef void (*tileRenderer)(const frustum &f, int width, int height,
+                             unsigned char *rgb, void *data);
+
+/* Procedure prototypes */
+bool renderPoster(const char* filename, const frustum &f, int width,
+                  int height, int samples, int tile_width, int tile_height,
+                  tileRenderer render, void *data);
+int posterMain(int argc, char** argv);
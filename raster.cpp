@@ -0,0 +1,230 @@
+/******************************************************************************
+ *    File : raster.cpp
+ * Descrip : Implementation file for software rendering of plant cones. This
+ *           follows the lighting set up by initLighting() and setLight(),
+ *           with colors computed per vertex and interpolated like
+ *           GL_SMOOTH shading.
+ *****************************************************************************/
+
+/* Include files */
+#include "raster.h"
+#include "params.h"
+#include <math.h>                       /* Need math functions */
+#include <string.h>                     /* String operations */
+
+/* Constants */
+#define AMBIENT_R (0.66*0.25)           /* (Global+light1 ambient) * GREY */
+#define AMBIENT_G (0.66*0.45)
+#define AMBIENT_B (0.66*0.35)
+
+/* Types */
+typedef struct vertex {
+    float eye[3];                       /* Position in eye coordinates */
+    float color[3];                     /* Lit color */
+} vertex;
+
+/* Frustum used by display() for a window of this size */
+frustum windowFrustum(int width, int height)
+{
+    frustum f = {-width/1000.0f, width/1000.0f,
+                 -height/1000.0f, height/1000.0f, 1.0f, 1000.0f};
+    return f;
+}
+
+/* Fill a triangle whose vertices are all in front of the near plane */
+static void fillTriangle(canvas &t, const vertex *v[3])
+{
+    const frustum &f = t.f;
+    float sx[3], sy[3], iz[3];
+
+    /* Project to pixel coordinates */
+    for (int i=0; i<3; i++)
+    {
+        iz[i] = -1/v[i]->eye[2];
+        sx[i] = (f.znear*v[i]->eye[0]*iz[i] - f.left) /
+                (f.right-f.left) * t.width;
+        sy[i] = (f.znear*v[i]->eye[1]*iz[i] - f.bottom) /
+                (f.top-f.bottom) * t.height;
+    }
+    float area = (sx[1]-sx[0])*(sy[2]-sy[0]) - (sx[2]-sx[0])*(sy[1]-sy[0]);
+    if (area == 0)
+        return;
+
+    int x0 = (int)fmax(floor(fmin(sx[0], fmin(sx[1], sx[2]))), 0);
+    int x1 = (int)fmin(ceil(fmax(sx[0], fmax(sx[1], sx[2]))), t.width-1);
+    int y0 = (int)fmax(floor(fmin(sy[0], fmin(sy[1], sy[2]))), 0);
+    int y1 = (int)fmin(ceil(fmax(sy[0], fmax(sy[1], sy[2]))), t.height-1);
+
+    for (int y=y0; y<=y1; y++)
+        for (int x=x0; x<=x1; x++)
+        {
+            /* Barycentric weights at pixel center */
+            float px = x + 0.5f, py = y + 0.5f;
+            float w0 = ((sx[1]-px)*(sy[2]-py) - (sx[2]-px)*(sy[1]-py))/area;
+            float w1 = ((sx[2]-px)*(sy[0]-py) - (sx[0]-px)*(sy[2]-py))/area;
+            float w2 = 1 - w0 - w1;
+            if (w0 < 0 || w1 < 0 || w2 < 0)
+                continue;
+
+            float z = w0*iz[0] + w1*iz[1] + w2*iz[2];
+            float *depth = &t.depth[y*t.width + x];
+            if (z <= *depth || z > 1/f.znear || z < 1/f.zfar)
+                continue;
+            *depth = z;
+
+            unsigned char *rgb = &t.rgb[3*(y*t.width + x)];
+            for (int c=0; c<3; c++)
+            {
+                float value = w0*v[0]->color[c] + w1*v[1]->color[c] +
+                              w2*v[2]->color[c];
+                rgb[c] = (unsigned char)(fmin(fmax(value, 0), 1)*255 + 0.5);
+            }
+        }
+}
+
+/* Point on edge a-b where it crosses the near plane */
+static vertex nearCrossing(const vertex &a, const vertex &b, float znear)
+{
+    vertex v;
+    float s = (-znear - a.eye[2])/(b.eye[2] - a.eye[2]);
+    for (int i=0; i<3; i++)
+    {
+        v.eye[i] = a.eye[i] + s*(b.eye[i] - a.eye[i]);
+        v.color[i] = a.color[i] + s*(b.color[i] - a.color[i]);
+    }
+    return v;
+}
+
+/* Clip triangle against near plane and fill what is left */
+static void drawTriangle(canvas &t, const vertex &a, const vertex &b,
+                         const vertex &c)
+{
+    const vertex *in[3] = {&a, &b, &c};
+    vertex poly[4];
+    int n = 0;
+    float znear = t.f.znear;
+
+    for (int i=0; i<3; i++)
+    {
+        const vertex &p = *in[i];
+        const vertex &q = *in[(i+1)%3];
+        bool p_in = p.eye[2] <= -znear;
+        bool q_in = q.eye[2] <= -znear;
+        if (p_in)
+            poly[n++] = p;
+        if (p_in != q_in)
+            poly[n++] = nearCrossing(p, q, znear);
+    }
+    for (int i=2; i<n; i++)
+    {
+        const vertex *tri[3] = {&poly[0], &poly[i-1], &poly[i]};
+        fillTriangle(t, tri);
+    }
+}
+
+/* Light and transform one cone vertex, same as drawCylVertex() */
+static void coneVertex(const cone &c, const float view[16], const float *light,
+                       float jangle, float rad, float height, vertex &v)
+{
+    float local[3] = {rad*(float)cos(jangle), rad*(float)sin(jangle), height};
+    float world[3], n[3];
+    for (int i=0; i<3; i++)
+    {
+        world[i] = c.mat[i]*local[0] + c.mat[4+i]*local[1] +
+                   c.mat[8+i]*local[2] + c.mat[12+i];
+        n[i] = c.mat[i]*cos(jangle) + c.mat[4+i]*sin(jangle);
+    }
+    for (int i=0; i<3; i++)
+        v.eye[i] = view[i]*world[0] + view[4+i]*world[1] +
+                   view[8+i]*world[2] + view[12+i];
+
+    float diffuse = fmax(n[0]*light[0] + n[1]*light[1] + n[2]*light[2], 0);
+    v.color[0] = AMBIENT_R + diffuse*c.color[0];
+    v.color[1] = AMBIENT_G + diffuse*c.color[1];
+    v.color[2] = AMBIENT_B + diffuse*c.color[2];
+}
+
+/* Start rendering into rgb, which is width by height pixels of 3 bytes,
+   bottom row first like glReadPixels */
+void canvasBegin(canvas &c, const float view[16], const frustum &f,
+                 int width, int height, unsigned char *rgb)
+{
+    memcpy(c.view, view, sizeof(c.view));
+    c.f = f;
+    c.width = width;
+    c.height = height;
+    c.rgb = rgb;
+    c.depth.assign(width*height, 0);
+    memset(rgb, 0, 3*width*height);
+
+    /* Direction of light1 in world coordinates, see setLight() */
+    float light[3] = {-0.4f, 1.0f, 0.5f};
+    float len = sqrt(light[0]*light[0] + light[1]*light[1] + light[2]*light[2]);
+    for (int i=0; i<3; i++)
+        c.light[i] = light[i]/len;
+}
+
+/* True if the sphere around cone is wholly outside the frustum, so a
+   canvas that is one tile of a poster skips most of the plant */
+static bool outside(const canvas &t, const cone &c)
+{
+    const frustum &f = t.f;
+    float world[3], eye[3];
+    for (int i=0; i<3; i++)
+        world[i] = c.mat[i+8]*c.height/2 + c.mat[12+i];
+    for (int i=0; i<3; i++)
+        eye[i] = t.view[i]*world[0] + t.view[4+i]*world[1] +
+                 t.view[8+i]*world[2] + t.view[12+i];
+    float r = fmax(c.rad, c.rad2) + c.height/2;
+
+    /* Distance inside each plane, the side planes pass through the eye */
+    if (-eye[2] + r < f.znear || -eye[2] - r > f.zfar)
+        return true;
+    if ((eye[0]*f.znear + f.left*eye[2]) <
+            -r*sqrt(f.znear*f.znear + f.left*f.left) ||
+        (-eye[0]*f.znear - f.right*eye[2]) <
+            -r*sqrt(f.znear*f.znear + f.right*f.right) ||
+        (eye[1]*f.znear + f.bottom*eye[2]) <
+            -r*sqrt(f.znear*f.znear + f.bottom*f.bottom) ||
+        (-eye[1]*f.znear - f.top*eye[2]) <
+            -r*sqrt(f.znear*f.znear + f.top*f.top))
+        return true;
+    return false;
+}
+
+/* Draw cones onto canvas passed as data, usable as a coneSink */
+void canvasDraw(const cone *cones, int n, void *data)
+{
+    canvas &t = *(canvas *)data;
+    vertex ring[2*(CONE_APPROX+1)];
+    for (int i=0; i<n; i++)
+    {
+        const cone &c = cones[i];
+        if (outside(t, c))
+            continue;
+        for (int j=0; j<=CONE_APPROX; j++)
+        {
+            float jangle = j * M_PI * 2 / CONE_APPROX;
+            coneVertex(c, t.view, t.light, jangle, c.rad, 0, ring[2*j]);
+            coneVertex(c, t.view, t.light, jangle, c.rad2, c.height,
+                       ring[2*j+1]);
+        }
+
+        /* Same quad strip as drawCone() */
+        for (int j=0; j<CONE_APPROX; j++)
+        {
+            drawTriangle(t, ring[2*j], ring[2*j+1], ring[2*j+2]);
+            drawTriangle(t, ring[2*j+1], ring[2*j+3], ring[2*j+2]);
+        }
+    }
+}
+
+/* Render cones seen through view and frustum into rgb */
+void renderCones(const std::vector<cone> &cones, const float view[16],
+                 const frustum &f, int width, int height, unsigned char *rgb)
+{
+    canvas c;
+    canvasBegin(c, view, f, width, height, rgb);
+    if (!cones.empty())
+        canvasDraw(&cones[0], cones.size(), &c);
+}
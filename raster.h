@@ -0,0 +1,34 @@
+/******************************************************************************
+ *    File : raster.h
+ * Descrip : Header file for software rendering of plant cones, used when
+ *           there is no window to render to
+ *****************************************************************************/
+
+#pragma once
+
+#include "grow.h"
+#include <vector>
+
+/* Types */
+typedef struct frustum {
+    float left, right;                  /* Same as glFrustum parameters */
+    float bottom, top;
+    float znear, zfar;
+} frustum;
+
+typedef struct canvas {
+    float view[16];                     /* World to eye transform */
+    frustum f;                          /* View frustum */
+    int width, height;                  /* Image size */
+    unsigned char *rgb;                 /* Color buffer, bottom row first */
+    std::vector<float> depth;           /* 1/z buffer, larger is closer */
+    float light[3];                     /* Light direction in world */
+} canvas;
+
+/* Procedure prototypes */
+frustum windowFrustum(int width, int height);
+void canvasBegin(canvas &c, const float view[16], const frustum &f,
+                 int width, int height, unsigned char *rgb);
+void canvasDraw(const cone *cones, int n, void *data);
+void renderCones(const std::vector<cone> &cones, const float view[16],
+                 const frustum &f, int width, int height, unsigned char *rgb);
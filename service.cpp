@@ -0,0 +1,430 @@
+/******************************************************************************
+ *    File : service.cpp
+ * Descrip : Implementation file for the render service. Each client sends
+ *           requests a line at a time and gets a header line back, then
+ *           the data it asked for:
+ *
+ *             image [key=value ...]  ->  ok <width> <height> <bytes>
+ *                                        RGB bytes, bottom row first
+ *             cones [key=value ...]  ->  ok <cones> <bytes>
+ *                                        cone structs as laid out in grow.h
+ *             stats                  ->  ok plants=<n> frames=<n> hits=<n>
+ *                                        misses=<n>
+ *
+ *           or "error <reason>". Keys are state=<file> seed=<n> time=<t>
+ *           width=<w> height=<h> turn=<degrees> and view=<16 comma
+ *           separated floats>, which replaces the view of the state file.
+ *
+ *           Plants are kept grown in an LRU cache keyed by state file and
+ *           seed, and the cones of each frame in another keyed by time as
+ *           well, so a plant that was asked for before costs only the
+ *           render. Each plant has its own lock and random numbers, so
+ *           several threads grow and render different plants at once.
+ *           A plant is only grown from its start in the same steps, to the
+ *           first step at or past the frame asked for, and started again
+ *           when asked for an earlier step. Frames are generated on a copy
+ *           of it, so a frame is the same whatever was asked for before.
+ *
+ *           Usage: plant-grow --serve <socket> [options]
+ *           Options: --threads <n> --plants <n> --frames <n>
+ *****************************************************************************/
+
+/* Include files */
+#include "service.h"
+#include "grow.h"
+#include "raster.h"
+#include "matrix.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>                      /* For file operations */
+#include <stdlib.h>
+#include <string.h>                     /* String operations */
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/* Constants */
+#define SERVICE_STEP 0.05               /* Time step growing a plant */
+#define SERVICE_MAX_SIZE 8192           /* Largest image served */
+#define SERVICE_LINE 4096               /* Longest request */
+
+/* Types */
+typedef struct request {
+    char command[16];                   /* image, cones or stats */
+    char state[256];                    /* State file, empty for new plant */
+    unsigned int seed;                  /* Seed for stocastic plant */
+    float time;                         /* Plant time, -1 for state's time */
+    int width, height;                  /* Image size */
+    float turn;                         /* Turn of camera about trunk */
+    bool has_view;                      /* True if view was given */
+    float view[16];                     /* World to eye transform */
+} request;
+
+typedef struct grownPlant {
+    std::mutex mutex;                   /* Guards everything below */
+    bool ready;                         /* False until state is loaded */
+    plant p;                            /* Plant grown so far */
+    float start[16];                    /* View of state file */
+    float start_time;                   /* Time of state file */
+    int steps;                          /* Steps grown from start_time */
+} grownPlant;
+
+typedef std::vector<cone> coneList;
+
+/* Least recently used cache of shared items, each with its own lock */
+template <class T>
+struct lruCache {
+    typedef std::pair<std::string, std::shared_ptr<T> > item;
+    std::mutex mutex;                   /* Guards items and index */
+    size_t limit;                       /* Most items kept */
+    std::list<item> items;              /* Most recently used first */
+    std::unordered_map<std::string, typename std::list<item>::iterator> index;
+};
+
+/* Variables local to this file */
+static lruCache<grownPlant> plants;     /* Plants by state and seed */
+static lruCache<const coneList> frames; /* Cones by state, seed and time */
+static std::atomic<long> hits(0);       /* Frames found in cache */
+static std::atomic<long> misses(0);     /* Frames generated */
+
+/* Find item, making it most recently used. Returns NULL if not found. */
+template <class T>
+static std::shared_ptr<T> cacheFind(lruCache<T> &cache, const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto i = cache.index.find(key);
+    if (i == cache.index.end())
+        return NULL;
+    cache.items.splice(cache.items.begin(), cache.items, i->second);
+    return i->second->second;
+}
+
+/* Add item, or return the one already there, evicting the least recently
+   used. Evicted items live on until the last thread using them is done. */
+template <class T>
+static std::shared_ptr<T> cacheAdd(lruCache<T> &cache, const std::string &key,
+                                   std::shared_ptr<T> value)
+{
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto i = cache.index.find(key);
+    if (i != cache.index.end())
+    {
+        cache.items.splice(cache.items.begin(), cache.items, i->second);
+        return i->second->second;
+    }
+    cache.items.push_front(std::make_pair(key, value));
+    cache.index[key] = cache.items.begin();
+    while (cache.items.size() > cache.limit)
+    {
+        cache.index.erase(cache.items.back().first);
+        cache.items.pop_back();
+    }
+    return value;
+}
+
+/* Number of items in cache */
+template <class T>
+static int cacheSize(lruCache<T> &cache)
+{
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    return cache.items.size();
+}
+
+/* Parse a request line, false if it is not understood */
+static bool parseRequest(char *line, request &req)
+{
+    memset(&req, 0, sizeof(req));
+    req.time = -1;
+    req.width = 500;
+    req.height = 500;
+    char *save;
+    char *word = strtok_r(line, " \t\r\n", &save);
+    if (word == NULL)
+        return false;
+    snprintf(req.command, sizeof(req.command), "%s", word);
+    while ((word = strtok_r(NULL, " \t\r\n", &save)) != NULL)
+    {
+        char *value = strchr(word, '=');
+        if (value == NULL)
+            return false;
+        *value++ = 0;
+        if (strcmp(word, "state") == 0)
+            snprintf(req.state, sizeof(req.state), "%s", value);
+        else if (strcmp(word, "seed") == 0)
+            req.seed = strtoul(value, NULL, 10);
+        else if (strcmp(word, "time") == 0)
+            req.time = atof(value);
+        else if (strcmp(word, "width") == 0)
+            req.width = atoi(value);
+        else if (strcmp(word, "height") == 0)
+            req.height = atoi(value);
+        else if (strcmp(word, "turn") == 0)
+            req.turn = atof(value);
+        else if (strcmp(word, "view") == 0)
+        {
+            char *end = value;
+            for (int i=0; i<16; i++)
+            {
+                req.view[i] = strtof(end, &end);
+                if (i < 15 && *end++ != ',')
+                    return false;
+            }
+            req.has_view = true;
+        }
+        else
+            return false;
+    }
+    return true;
+}
+
+/* Start plant of request over from its state file, or new if none. Called
+   with plant locked. Returns false if the state file can't be read. */
+static bool startPlant(grownPlant &g, const request &req)
+{
+    initPlant(g.p);
+    seedPlant(g.p, req.seed);
+    matIdentity(g.start);
+    matTranslate(g.start, 0.0, 0.0, -15.0);
+    g.ready = !req.state[0] || load_state(g.p, req.state, g.start);
+    g.start_time = g.p.time_cur;
+    g.steps = 0;
+    return g.ready;
+}
+
+/* Plant for state and seed, loaded but not yet grown. NULL if the state
+   file can't be read. */
+static std::shared_ptr<grownPlant> findPlant(const request &req,
+                                             const std::string &key)
+{
+    std::shared_ptr<grownPlant> g = cacheFind(plants, key);
+    if (!g)
+        g = cacheAdd(plants, key, std::make_shared<grownPlant>());
+    std::lock_guard<std::mutex> lock(g->mutex);
+    if (!g->ready && !startPlant(*g, req))
+        return NULL;
+    return g;
+}
+
+/* Cones of a frame, from cache or grown. NULL if the plant can't be made. */
+static std::shared_ptr<const coneList> findFrame(const request &req,
+                                                 float start[16])
+{
+    char seed[32], time[32];
+    snprintf(seed, sizeof(seed), "%u", req.seed);
+    std::string plant_key = std::string(req.state) + "\n" + seed;
+    std::shared_ptr<grownPlant> g = findPlant(req, plant_key);
+    if (!g)
+        return NULL;
+    memcpy(start, g->start, 16*sizeof(float));
+    float t = req.time < 0 ? g->start_time : req.time;
+    snprintf(time, sizeof(time), "%.9g", t);
+    std::string key = plant_key + "\n" + time;
+    std::shared_ptr<const coneList> cones = cacheFind(frames, key);
+    if (cones)
+    {
+        hits++;
+        return cones;
+    }
+
+    /* A stocastic plant makes different nodes depending on the times it
+       is generated at, so it is only grown in fixed steps from its start,
+       to the first step at or past t, and started again if it has grown
+       past that. The frame is generated on a copy, as generating between
+       steps can make nodes and moves the growth caches on. */
+    std::lock_guard<std::mutex> lock(g->mutex);
+    if ((cones = cacheFind(frames, key)))
+    {
+        hits++;
+        return cones;
+    }
+    misses++;
+    coneSink skip = {NULL, NULL};
+    int steps = 0;
+    if (t > g->start_time)
+        steps = (int)ceilf((t - g->start_time)/SERVICE_STEP);
+    if (steps < g->steps && !startPlant(*g, req))
+        return NULL;
+    for (; g->steps < steps; g->steps++)
+    {
+        g->p.time_cur = g->start_time + (g->steps+1)*SERVICE_STEP;
+        generate(g->p, skip);
+    }
+    plant frame = g->p;
+    frame.time_cur = t;
+    std::shared_ptr<coneList> made = std::make_shared<coneList>();
+    generate(frame, *made);
+    return cacheAdd(frames, key, std::shared_ptr<const coneList>(made));
+}
+
+/* Write all of buffer to fd */
+static bool writeAll(int fd, const void *data, size_t size)
+{
+    const char *p = (const char *)data;
+    while (size > 0)
+    {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+/* Write a response header line */
+static bool reply(int fd, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+static bool reply(int fd, const char *format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    return writeAll(fd, line, strlen(line));
+}
+
+/* Answer one request, false if the client has gone */
+static bool answer(int fd, char *line)
+{
+    request req;
+    if (!parseRequest(line, req))
+        return reply(fd, "error bad request\n");
+    if (strcmp(req.command, "stats") == 0)
+        return reply(fd, "ok plants=%d frames=%d hits=%ld misses=%ld\n",
+                     cacheSize(plants), cacheSize(frames), hits.load(),
+                     misses.load());
+    bool image = strcmp(req.command, "image") == 0;
+    if (!image && strcmp(req.command, "cones") != 0)
+        return reply(fd, "error unknown command %s\n", req.command);
+    if (req.width < 1 || req.height < 1 || req.width > SERVICE_MAX_SIZE ||
+        req.height > SERVICE_MAX_SIZE)
+        return reply(fd, "error bad size\n");
+
+    float view[16];
+    std::shared_ptr<const coneList> cones = findFrame(req, view);
+    if (!cones)
+        return reply(fd, "error can't read %s\n", req.state);
+    if (!image)
+    {
+        size_t bytes = cones->size()*sizeof(cone);
+        return reply(fd, "ok %d %zu\n", (int)cones->size(), bytes) &&
+               (bytes == 0 || writeAll(fd, &(*cones)[0], bytes));
+    }
+
+    /* Turn camera about the trunk like the render farm */
+    if (req.has_view)
+        memcpy(view, req.view, sizeof(view));
+    matTranslate(view, STARTX, 0, -STARTY);
+    matRotateY(view, req.turn);
+    matTranslate(view, -STARTX, 0, STARTY);
+    std::vector<unsigned char> rgb(3*req.width*req.height);
+    renderCones(*cones, view, windowFrustum(req.width, req.height),
+                req.width, req.height, &rgb[0]);
+    return reply(fd, "ok %d %d %zu\n", req.width, req.height, rgb.size()) &&
+           writeAll(fd, &rgb[0], rgb.size());
+}
+
+/* Serve requests of one client until it closes */
+static void serveClient(int fd)
+{
+    FILE *in = fdopen(dup(fd), "r");
+    char line[SERVICE_LINE];
+    if (in == NULL)
+        return;
+    while (fgets(line, sizeof(line), in))
+        if (!answer(fd, line))
+            break;
+    fclose(in);
+}
+
+/* Take clients off the listening socket one at a time */
+static void serveLoop(int listener)
+{
+    while (true)
+    {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            perror("accept");
+            return;
+        }
+        serveClient(fd);
+        close(fd);
+    }
+}
+
+/* Listen on a Unix socket and serve clients with a pool of threads */
+int serviceMain(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        fprintf(stderr, "usage: plant-grow --serve <socket> [options]\n");
+        return 2;
+    }
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    plants.limit = 16;
+    frames.limit = 256;
+    for (int i=1; i<argc; i++)
+    {
+        bool more = i+1 < argc;
+        if (strcmp(argv[i], "--threads") == 0 && more)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--plants") == 0 && more)
+            plants.limit = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--frames") == 0 && more)
+            frames.limit = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (threads < 1 || plants.limit < 1 || frames.limit < 1)
+    {
+        fprintf(stderr, "bad service parameters\n");
+        return 2;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(argv[0]) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "%s: socket path too long\n", argv[0]);
+        return 2;
+    }
+    strcpy(addr.sun_path, argv[0]);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(argv[0]);
+    if (listener < 0 ||
+        bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listener, 64) < 0)
+    {
+        perror(argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);           /* Clients may hang up mid reply */
+
+    std::vector<std::thread> pool;
+    for (int i=0; i<threads; i++)
+        pool.push_back(std::thread(serveLoop, listener));
+    for (int i=0; i<threads; i++)
+        pool[i].join();
+    close(listener);
+    unlink(argv[0]);
+    return 1;
+}
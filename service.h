@@ -0,0 +1,10 @@
+/******************************************************************************
+ *    File : service.h
+ * Descrip : Header file for the render service, which serves images and
+ *           geometry of plants to local clients over a Unix socket
+ *****************************************************************************/
+
+#pragma once
+
+/* Procedure prototypes */
+int serviceMain(int argc, char** argv);
@@ -0,0 +1,233 @@
+/******************************************************************************
+ *    File : session.cpp
+ * Descrip : Implementation file for input sessions. A session file starts
+ *           with the seed, window size and state file the run began with,
+ *           then lists each keyboard, mouse, motion and reshape event with
+ *           the frame it came before, and ends with the number of frames
+ *           run. The count is written however the program exits; a session
+ *           cut short without it replays up to its last event. While
+ *           recording or replaying, every frame takes exactly one
+ *           simulation tick, so a replay grows and moves the same way each
+ *           time whatever the speed of the machine. A replay writes the
+ *           time each frame took to a report.
+ *
+ *           Usage: plant-grow --record <session> [state file]
+ *                  plant-grow --replay <session> [report]
+ *****************************************************************************/
+
+/* Include files */
+#include "session.h"
+#include <algorithm>
+#include <stdio.h>                      /* For file operations */
+#include <stdlib.h>
+#include <string.h>                     /* String operations */
+#include <vector>
+
+/* Types */
+typedef struct frameTiming {
+    double sim;                         /* Seconds taking simulation tick */
+    double draw;                        /* Seconds drawing and finishing */
+    int cones;                          /* Cones drawn */
+} frameTiming;
+
+/* Variables local to this file */
+static int mode = SESSION_OFF;          /* What session is doing */
+static FILE *record = NULL;             /* Session being recorded */
+static int frame = 0;                   /* Frames done */
+static int frames = 0;                  /* Frames in replay */
+static std::vector<sessionEvent> events; /* Events of replay */
+static int next_event = 0;              /* Next event to replay */
+static std::vector<frameTiming> timing; /* Time each replay frame took */
+static char report_name[256];           /* Report of replay */
+
+/* Order of events in replay */
+static bool earlier(const sessionEvent &a, const sessionEvent &b)
+{
+    return a.frame < b.frame;
+}
+
+/* Start recording a session, to be finished by sessionStop or at exit */
+bool sessionRecord(const char* filename, const sessionInfo &info)
+{
+    static bool stop_at_exit = false;
+    record = fopen(filename, "w");
+    if (record == NULL)
+        return false;
+    fprintf(record, "seed=%u\nwidth=%d\nheight=%d\nstate=%s\n", info.seed,
+            info.width, info.height, info.state);
+    mode = SESSION_RECORD;
+    frame = 0;
+    if (!stop_at_exit)
+        stop_at_exit = atexit(sessionStop) == 0;
+    return true;
+}
+
+/* Read a session to replay, reporting frame times to report */
+bool sessionReplay(const char* filename, const char* report,
+                   sessionInfo &info)
+{
+    FILE *in = fopen(filename, "r");
+    char line[512];
+    if (in == NULL)
+        return false;
+    memset(&info, 0, sizeof(info));
+    events.clear();
+    frames = -1;
+    while (fgets(line, sizeof(line), in))
+    {
+        line[strcspn(line, "\n")] = 0;
+        char *value = strchr(line, '=');
+        if (value == NULL)
+            continue;
+        *value++ = 0;
+        sessionEvent e;
+        memset(&e, 0, sizeof(e));
+        if (strcmp(line, "seed") == 0)
+            info.seed = strtoul(value, NULL, 10);
+        else if (strcmp(line, "width") == 0)
+            info.width = atoi(value);
+        else if (strcmp(line, "height") == 0)
+            info.height = atoi(value);
+        else if (strcmp(line, "state") == 0)
+            snprintf(info.state, sizeof(info.state), "%s", value);
+        else if (strcmp(line, "frames") == 0)
+            frames = atoi(value);
+        else if (strcmp(line, "key") == 0 &&
+                 sscanf(value, "%d %d %d %d", &e.frame, &e.arg[0], &e.arg[1],
+                        &e.arg[2]) == 4)
+        {
+            e.type = SESSION_KEY;
+            events.push_back(e);
+        }
+        else if (strcmp(line, "mouse") == 0 &&
+                 sscanf(value, "%d %d %d %d %d", &e.frame, &e.arg[0],
+                        &e.arg[1], &e.arg[2], &e.arg[3]) == 5)
+        {
+            e.type = SESSION_MOUSE;
+            events.push_back(e);
+        }
+        else if (strcmp(line, "motion") == 0 &&
+                 sscanf(value, "%d %d %d", &e.frame, &e.arg[0],
+                        &e.arg[1]) == 3)
+        {
+            e.type = SESSION_MOTION;
+            events.push_back(e);
+        }
+        else if (strcmp(line, "reshape") == 0 &&
+                 sscanf(value, "%d %d %d", &e.frame, &e.arg[0],
+                        &e.arg[1]) == 3 && e.arg[0] > 0 && e.arg[1] > 0)
+        {
+            e.type = SESSION_RESHAPE;
+            events.push_back(e);
+        }
+    }
+    fclose(in);
+    if (info.width < 1 || info.height < 1)
+        return false;
+
+    /* Keep events of the same frame in the order they were recorded. A
+       session without a frame count ends after its last event. */
+    std::stable_sort(events.begin(), events.end(), earlier);
+    if (frames < 0)
+        frames = events.empty() ? 0 : events.back().frame + 1;
+    snprintf(report_name, sizeof(report_name), "%s", report);
+    timing.clear();
+    next_event = 0;
+    frame = 0;
+    mode = SESSION_REPLAY;
+    return true;
+}
+
+/* SESSION_OFF, SESSION_RECORD or SESSION_REPLAY */
+int sessionMode()
+{
+    return mode;
+}
+
+/* Record an input event before the next frame */
+void sessionLog(int type, int a, int b, int c, int d)
+{
+    if (mode != SESSION_RECORD)
+        return;
+    if (type == SESSION_KEY)
+        fprintf(record, "key=%d %d %d %d\n", frame, a, b, c);
+    else if (type == SESSION_MOUSE)
+        fprintf(record, "mouse=%d %d %d %d %d\n", frame, a, b, c, d);
+    else if (type == SESSION_MOTION)
+        fprintf(record, "motion=%d %d %d\n", frame, a, b);
+    else if (type == SESSION_RESHAPE)
+        fprintf(record, "reshape=%d %d %d\n", frame, a, b);
+}
+
+/* Get the next replayed event due before this frame, false if none */
+bool sessionNext(sessionEvent &e)
+{
+    if (mode != SESSION_REPLAY || next_event >= (int)events.size() ||
+        events[next_event].frame > frame)
+        return false;
+    e = events[next_event++];
+    return true;
+}
+
+/* Write per frame times and a summary of a replay */
+static void writeReport()
+{
+    FILE *out = fopen(report_name, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "%s: can't write report\n", report_name);
+        return;
+    }
+    std::vector<double> total;
+    fprintf(out, "frame,sim_ms,draw_ms,frame_ms,cones\n");
+    for (int i=0; i<(int)timing.size(); i++)
+    {
+        const frameTiming &t = timing[i];
+        total.push_back(t.sim + t.draw);
+        fprintf(out, "%d,%.3f,%.3f,%.3f,%d\n", i, t.sim*1e3, t.draw*1e3,
+                (t.sim + t.draw)*1e3, t.cones);
+    }
+    fclose(out);
+    if (total.empty())
+        return;
+
+    double sum = 0;
+    for (int i=0; i<(int)total.size(); i++)
+        sum += total[i];
+    std::sort(total.begin(), total.end());
+    int n = total.size();
+    printf("%d frames: mean %.3f ms, median %.3f ms, 95%% %.3f ms, "
+           "99%% %.3f ms, max %.3f ms\n", n, sum/n*1e3, total[n/2]*1e3,
+           total[n*95/100]*1e3, total[n*99/100]*1e3, total[n-1]*1e3);
+}
+
+/* Count a finished frame. Returns true once a replay has run all its
+   frames, after writing the report. A recording is flushed, so events up
+   to here survive a crash. */
+bool sessionFrameDone(double sim, double draw, int cones)
+{
+    frame++;
+    if (mode == SESSION_RECORD)
+        fflush(record);
+    if (mode != SESSION_REPLAY)
+        return false;
+    frameTiming t = {sim, draw, cones};
+    timing.push_back(t);
+    if (frame < frames)
+        return false;
+    writeReport();
+    mode = SESSION_OFF;
+    return true;
+}
+
+/* Finish recording with the number of frames run. Also called at exit,
+   so a window closed without 'q' still gets its count. */
+void sessionStop()
+{
+    if (mode != SESSION_RECORD)
+        return;
+    fprintf(record, "frames=%d\n", frame);
+    fclose(record);
+    record = NULL;
+    mode = SESSION_OFF;
+}
@@ -0,0 +1,41 @@
+/******************************************************************************
+ *    File : session.h
+ * Descrip : Header file for recording input sessions and replaying them
+ *           frame by frame for repeatable timing runs
+ *****************************************************************************/
+
+#pragma once
+
+/* Constants */
+#define SESSION_OFF 0                   /* Interactive, not recording */
+#define SESSION_RECORD 1                /* Logging input to a session */
+#define SESSION_REPLAY 2                /* Feeding input from a session */
+
+#define SESSION_KEY 0                   /* Keyboard: key, x, y */
+#define SESSION_MOUSE 1                 /* Mouse: button, state, x, y */
+#define SESSION_MOTION 2                /* Motion: x, y */
+#define SESSION_RESHAPE 3               /* Reshape: width, height */
+
+/* Types */
+typedef struct sessionInfo {
+    unsigned int seed;                  /* Seed for randomization */
+    int width, height;                  /* Window size */
+    char state[256];                    /* State file, empty for new plant */
+} sessionInfo;
+
+typedef struct sessionEvent {
+    int frame;                          /* Frame event is handled before */
+    int type;                           /* SESSION_KEY, MOUSE, MOTION or
+                                           RESHAPE */
+    int arg[4];                         /* Arguments of callback */
+} sessionEvent;
+
+/* Procedure prototypes */
+bool sessionRecord(const char* filename, const sessionInfo &info);
+bool sessionReplay(const char* filename, const char* report,
+                   sessionInfo &info);
+int sessionMode();
+void sessionLog(int type, int a, int b, int c, int d);
+bool sessionNext(sessionEvent &e);
+bool sessionFrameDone(double sim, double draw, int cones);
+void sessionStop();
@@ -0,0 +1,213 @@
+/******************************************************************************
+ *    File : sim.cpp
+ * Descrip : Implementation file for the simulation thread. Snapshots are
+ *           handed over through four slots: one being written by the
+ *           simulation, the newest and the one before it held by the
+ *           renderer, and one in between that the two threads swap with.
+ *****************************************************************************/
+
+/* Include files */
+#include "sim.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+/* Constants */
+#define SNAP_SLOTS 4                    /* Snapshot slots */
+#define SNAP_FRESH 4                    /* Set in sim_shared when unread */
+
+/* Variables local to this file */
+static plant sim_plant;                 /* Plant owned by simulation */
+static std::mutex sim_mutex;            /* Guards sim_plant */
+static std::thread *sim_thread = NULL;  /* Simulation thread */
+static std::atomic<bool> sim_quit(false); /* Stop simulation if true */
+static std::atomic<float> sim_step(0);  /* Time step per tick */
+static bool sim_dirty = true;           /* Publish even if time is still */
+static int sim_epoch = 0;               /* Bumped when state tree reloaded or
+                                           renumbered */
+static snapshot snaps[SNAP_SLOTS];      /* Snapshot slots */
+static int back_slot = 0;               /* Written by simulation */
+static std::atomic<int> sim_shared(1);  /* Swapped between threads */
+static int front_slot = 2;              /* Newest held by renderer */
+static int prev_slot = 3;               /* Previous held by renderer */
+
+/* Seconds on a monotonic clock */
+double wallTime()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Sort cones of snapshot by state, keeping their order within a state. A
+   state can make several cones, and its k-th cone is the same cone from one
+   snapshot to the next. */
+void indexSnapshot(snapshot &snap, int states)
+{
+    int cones = snap.cones.size();
+    snap.first.assign(states+1, 0);
+    for (int i=0; i<cones; i++)
+        snap.first[snap.cones[i].node+1]++;
+    for (int n=0; n<states; n++)
+        snap.first[n+1] += snap.first[n];
+    std::vector<int> at(snap.first.begin(), snap.first.end()-1);
+    snap.order.resize(cones);
+    snap.rank.resize(cones);
+    for (int i=0; i<cones; i++)
+    {
+        int n = snap.cones[i].node;
+        snap.rank[i] = at[n] - snap.first[n];
+        snap.order[at[n]++] = i;
+    }
+}
+
+/* Take one time step and publish a snapshot if the plant changed */
+static void simTick()
+{
+    snapshot &snap = snaps[back_slot];
+    {
+        std::lock_guard<std::mutex> lock(sim_mutex);
+        float time_step = sim_step;
+
+        /* Take one time step, but don't grow negative */
+        if ((sim_plant.time_cur > 0 || time_step > 0) && time_step != 0)
+        {
+            sim_plant.time_cur += time_step;
+            sim_dirty = true;
+        }
+        if (!sim_dirty)
+            return;
+        sim_dirty = false;
+        int renumbers = sim_plant.renumbers;
+        generate(sim_plant, snap.cones);
+        if (sim_plant.renumbers != renumbers)
+            sim_epoch++;                /* Earlier snapshots name other nodes */
+        snap.time_cur = sim_plant.time_cur;
+        snap.epoch = sim_epoch;
+
+        /* Keep the tree as it was, so a node picked in this snapshot is
+           looked up as it was drawn */
+        int n = sim_plant.nextFree + 1;
+        snap.states.assign(&sim_plant.states[0], &sim_plant.states[0] + n);
+        snap.node_time.assign(sim_plant.node_time.begin(),
+                              sim_plant.node_time.begin() + n);
+        snap.node_factor.assign(sim_plant.node_factor.begin(),
+                                sim_plant.node_factor.begin() + n);
+    }
+    indexSnapshot(snap, snap.states.size());
+    snap.wall = wallTime();
+    back_slot = sim_shared.exchange(back_slot | SNAP_FRESH) & ~SNAP_FRESH;
+}
+
+/* Run simulation at a fixed rate until stopped */
+static void simLoop()
+{
+    double next = wallTime();
+    while (!sim_quit)
+    {
+        simTick();
+        next += 1.0/SIM_RATE;
+        double now = wallTime();
+        if (next > now)
+            std::this_thread::sleep_for(std::chrono::duration<double>(next-now));
+        else if (now - next > 0.25)
+            next = now;                 /* Too far behind, don't catch up */
+    }
+}
+
+/* Start simulation thread */
+void simStart()
+{
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    if (sim_plant.states.empty())
+        initPlant(sim_plant);
+    if (sim_thread == NULL)
+        sim_thread = new std::thread(simLoop);
+}
+
+/* Take one tick on the calling thread instead of running the simulation
+   thread, so a tick can be tied to each frame */
+void simStep()
+{
+    {
+        std::lock_guard<std::mutex> lock(sim_mutex);
+        if (sim_plant.states.empty())
+            initPlant(sim_plant);
+    }
+    simTick();
+}
+
+/* Seed the random numbers the plant grows with */
+void simSeed(unsigned int seed)
+{
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    if (sim_plant.states.empty())
+        initPlant(sim_plant);
+    seedPlant(sim_plant, seed);
+}
+
+/* Stop simulation thread and wait for it */
+void simStop()
+{
+    if (sim_thread == NULL)
+        return;
+    sim_quit = true;
+    sim_thread->join();
+    delete sim_thread;
+    sim_thread = NULL;
+}
+
+/* Set time step taken every tick */
+void simSetStep(float time_step)
+{
+    sim_step = time_step;
+}
+
+/* Save state tree along with view */
+void simSave(const char* filename, const float view[16])
+{
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    save_state(sim_plant, filename, view);
+}
+
+/* Load state tree and view, false if the file can't be loaded */
+bool simLoad(const char* filename, float view[16])
+{
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    if (sim_plant.states.empty())
+        initPlant(sim_plant);
+    if (!load_state(sim_plant, filename, view))
+        return false;
+    sim_epoch++;
+    sim_dirty = true;
+    return true;
+}
+
+/* True if a snapshot was published that renderer has not acquired */
+bool simFresh()
+{
+    return sim_shared.load() & SNAP_FRESH;
+}
+
+/* Get newest snapshot and the one before it, both stay valid until the
+   next call. Only the render thread may call this. */
+void simAcquire(const snapshot *&cur, const snapshot *&prev)
+{
+    if (simFresh())
+    {
+        int newest = sim_shared.exchange(prev_slot) & ~SNAP_FRESH;
+        prev_slot = front_slot;
+        front_slot = newest;
+    }
+    cur = &snaps[front_slot];
+    prev = &snaps[prev_slot];
+}
+
+/* Look up a node in the state tree snapshot was made from */
+bool simInspect(const snapshot &snap, int node, nodeInfo &info)
+{
+    if (snap.states.empty())
+        return false;
+    return inspectNode(&snap.states[0], &snap.node_time[0],
+                       &snap.node_factor[0], snap.states.size(), node, info);
+}
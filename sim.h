@@ -0,0 +1,59 @@
+/******************************************************************************
+ *    File : sim.h
+ * Descrip : Header file for the simulation thread. The plant is grown at a
+ *           fixed rate on its own thread, which publishes snapshots of the
+ *           geometry for the render thread.
+ *****************************************************************************/
+
+#pragma once
+
+#include "grow.h"
+#include <vector>
+
+/* Constants */
+#define SIM_RATE 60                     /* Simulation steps per second */
+
+/* Types */
+typedef struct snapshot {
+    float time_cur;                     /* Plant time of this snapshot */
+    double wall;                        /* Wall clock time when published */
+    int epoch;                          /* Changes when state tree reloaded */
+    std::vector<cone> cones;            /* Geometry of whole plant */
+    std::vector<int> first;             /* Start of each state in order */
+    std::vector<int> order;             /* Cones by state, each state's in
+                                           the order they were made */
+    std::vector<int> rank;              /* Which cone of its state each
+                                           cone is */
+    std::vector<stored_state> states;   /* State tree cones were made from */
+    std::vector<float> node_time;       /* Growth time of each state */
+    std::vector<float> node_factor;     /* Growth factor of each state */
+} snapshot;
+
+/* Number of states snapshot has cones indexed for */
+static inline int snapshotStates(const snapshot &snap)
+{
+    return snap.first.empty() ? 0 : (int)snap.first.size() - 1;
+}
+
+/* Index in snapshot of the k-th cone of a state, NONE if it has none */
+static inline int stateCone(const snapshot &snap, int node, int k)
+{
+    if (node+1 >= (int)snap.first.size())
+        return NONE;
+    int at = snap.first[node] + k;
+    return at < snap.first[node+1] ? snap.order[at] : NONE;
+}
+
+/* Procedure prototypes */
+void simStart();
+void simStep();
+void simSeed(unsigned int seed);
+void simStop();
+void simSetStep(float time_step);
+void simSave(const char* filename, const float view[16]);
+bool simLoad(const char* filename, float view[16]);
+bool simFresh();
+void simAcquire(const snapshot *&cur, const snapshot *&prev);
+bool simInspect(const snapshot &snap, int node, nodeInfo &info);
+double wallTime();
+void indexSnapshot(snapshot &snap, int states);
@@ -0,0 +1,394 @@
+/******************************************************************************
+ *    File : sweep.cpp
+ * Descrip : Implementation file for parameter sweeps. Each parameter named
+ *           on the command line takes a range of values, and a plant is
+ *           grown with every combination of them to the same time from the
+ *           same seed. Plants are grown and rendered in child processes,
+ *           one per core, straight into a contact sheet in shared memory,
+ *           so a variant whose tree overflows only loses its own cell.
+ *           The sheet is written as a bitmap, with an index of the values
+ *           and size of the plant in each cell.
+ *
+ *           Usage: plant-grow --sweep <sheet.bmp> [options] <name>=<value>
+ *                  plant-grow --sweep <sheet.bmp> [options]
+ *                             <name>=<from>:<to>:<steps> ...
+ *           Options: --seed <n> --time <t> --thumb <pixels> --jobs <n>
+ *                    --columns <n>
+ *           Names are the lower case tree parameters of params.h, such as
+ *           azim_spin or leaf_outward_angle. Combinations go across the
+ *           sheet with the last parameter changing fastest.
+ *****************************************************************************/
+
+/* Include files */
+#include "sweep.h"
+#include "grow.h"
+#include "raster.h"
+#include "matrix.h"
+#include "bitmap.h"
+#include "sim.h"
+#include <math.h>                       /* Need math functions */
+#include <stddef.h>
+#include <stdio.h>                      /* For file operations */
+#include <stdlib.h>
+#include <string.h>                     /* String operations */
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Constants */
+#define SWEEP_STEP 0.05                 /* Time step growing to sweep time */
+#define SWEEP_FRAME 500                 /* Window size thumbnail is framed as */
+#define SWEEP_SAMPLES 2                 /* Supersampling of thumbnails */
+#define SWEEP_GAP 4                     /* Pixels between thumbnails */
+#define SWEEP_MAX 4096                  /* Most variants in one sweep */
+#define SWEEP_SIDE 32768                /* Most pixels across the sheet */
+#define SWEEP_DONE 1                    /* Variant status when rendered */
+
+/* Types */
+typedef struct sweepParam {
+    const char *name;                   /* Name on command line */
+    size_t offset;                      /* Offset in species */
+    bool integer;                       /* True if an int, else a float */
+} sweepParam;
+
+typedef struct sweepAxis {
+    int param;                          /* Index in sweep_params */
+    float from, to;                     /* Range of values */
+    int steps;                          /* Values in range */
+} sweepAxis;
+
+typedef struct sweepResult {
+    int status;                         /* SWEEP_DONE once rendered */
+    int nodes;                          /* States in tree */
+    int cones;                          /* Cones generated */
+} sweepResult;
+
+typedef struct sweepJob {
+    std::vector<sweepAxis> axes;        /* Parameters swept */
+    unsigned int seed;                  /* Seed of every plant */
+    float time;                         /* Time every plant is grown to */
+    int thumb;                          /* Thumbnail size in pixels */
+    int cols, rows;                     /* Thumbnails across and down */
+    int width, height;                  /* Sheet size */
+    unsigned char *rgb;                 /* Sheet, shared with children */
+    sweepResult *results;               /* Result of each variant, shared */
+} sweepJob;
+
+static const sweepParam sweep_params[] = {
+    {"azim_spin", offsetof(species, azim_spin), false},
+    {"turn_spin", offsetof(species, turn_spin), false},
+    {"branch_per_apex", offsetof(species, branch_per_apex), true},
+    {"leaf_outward_angle", offsetof(species, leaf_outward_angle), false},
+    {"leaf_to_twig_ratio", offsetof(species, leaf_to_twig_ratio), false},
+    {"big_azim_spin", offsetof(species, big_azim_spin), false},
+    {"big_turn_spin", offsetof(species, big_turn_spin), false},
+    {"big_branch_per_apex", offsetof(species, big_branch_per_apex), true},
+    {"big_leaf_outward_angle", offsetof(species, big_leaf_outward_angle),
+     false},
+};
+#define SWEEP_PARAMS (int)(sizeof(sweep_params)/sizeof(sweep_params[0]))
+
+/* Parse <name>=<value> or <name>=<from>:<to>:<steps> */
+static bool parseAxis(const char *arg, sweepAxis &axis)
+{
+    const char *value = strchr(arg, '=');
+    if (value == NULL)
+        return false;
+    std::string name(arg, value - arg);
+    axis.param = -1;
+    for (int i=0; i<SWEEP_PARAMS; i++)
+        if (name == sweep_params[i].name)
+            axis.param = i;
+    if (axis.param < 0)
+        return false;
+    axis.steps = 1;
+    int n = sscanf(value+1, "%f:%f:%d", &axis.from, &axis.to, &axis.steps);
+    if (n == 1)
+        axis.to = axis.from;
+    return (n == 1 || n == 3) && axis.steps > 0;
+}
+
+/* Value of axis at step k */
+static float axisValue(const sweepAxis &axis, int k)
+{
+    float v = axis.from;
+    if (axis.steps > 1)
+        v += k*(axis.to - axis.from)/(axis.steps - 1);
+    return sweep_params[axis.param].integer ? roundf(v) : v;
+}
+
+/* Species of variant, the last axis changing fastest */
+static void variantSpecies(const sweepJob &job, int variant, species &kind)
+{
+    defaultSpecies(kind);
+    for (int a=job.axes.size()-1; a>=0; a--)
+    {
+        const sweepAxis &axis = job.axes[a];
+        const sweepParam &param = sweep_params[axis.param];
+        float v = axisValue(axis, variant % axis.steps);
+        variant /= axis.steps;
+        char *field = (char *)&kind + param.offset;
+        if (param.integer)
+            *(int *)field = (int)v;
+        else
+            *(float *)field = v;
+    }
+}
+
+/* Corner of the cell of variant in the sheet, first rows at the top */
+static void cellCorner(const sweepJob &job, int variant, int &x, int &y)
+{
+    int cell = job.thumb + SWEEP_GAP;
+    x = SWEEP_GAP + (variant % job.cols)*cell;
+    y = SWEEP_GAP + (job.rows - 1 - variant/job.cols)*cell;
+}
+
+/* Fill the cell of variant with one color */
+static void fillCell(sweepJob &job, int variant, const unsigned char rgb[3])
+{
+    int x0, y0;
+    cellCorner(job, variant, x0, y0);
+    for (int y=0; y<job.thumb; y++)
+        for (int x=0; x<job.thumb; x++)
+            memcpy(&job.rgb[3*((y0+y)*job.width + x0+x)], rgb, 3);
+}
+
+/* Grow and render one variant into its cell. Runs in a child process. */
+static void renderVariant(sweepJob &job, int variant)
+{
+    plant p;
+    std::vector<cone> cones;
+    coneSink skip = {NULL, NULL};
+    initPlant(p);
+    seedPlant(p, job.seed);
+    variantSpecies(job, variant, p.kind);
+    while (p.time_cur + SWEEP_STEP < job.time)
+    {
+        p.time_cur += SWEEP_STEP;
+        generate(p, skip);
+    }
+    p.time_cur = job.time;
+    generate(p, cones);
+
+    /* Render supersampled and box filter down into the cell */
+    int big = job.thumb*SWEEP_SAMPLES;
+    std::vector<unsigned char> rgb(3*big*big);
+    float view[16];
+    matIdentity(view);
+    matTranslate(view, 0.0, 0.0, -15.0);
+    renderCones(cones, view, windowFrustum(SWEEP_FRAME, SWEEP_FRAME), big,
+                big, &rgb[0]);
+    int x0, y0;
+    cellCorner(job, variant, x0, y0);
+    int area = SWEEP_SAMPLES*SWEEP_SAMPLES;
+    for (int y=0; y<job.thumb; y++)
+        for (int x=0; x<job.thumb; x++)
+            for (int c=0; c<3; c++)
+            {
+                int sum = 0;
+                for (int sy=0; sy<SWEEP_SAMPLES; sy++)
+                    for (int sx=0; sx<SWEEP_SAMPLES; sx++)
+                        sum += rgb[3*((y*SWEEP_SAMPLES + sy)*big +
+                                      x*SWEEP_SAMPLES + sx) + c];
+                job.rgb[3*((y0+y)*job.width + x0+x) + c] = sum/area;
+            }
+
+    sweepResult &r = job.results[variant];
+    r.nodes = p.nextFree + 1;
+    r.cones = cones.size();
+    r.status = SWEEP_DONE;
+}
+
+/* Write index of the values and size of the plant in each cell */
+static bool writeIndex(const std::string &name, const sweepJob &job,
+                       int variants)
+{
+    FILE *out = fopen(name.c_str(), "w");
+    if (out == NULL)
+        return false;
+    fprintf(out, "seed=%u\ntime=%.9g\nthumb=%d\ncolumns=%d\nrows=%d\n"
+            "gap=%d\n", job.seed, job.time, job.thumb, job.cols, job.rows,
+            SWEEP_GAP);
+    for (int v=0; v<variants; v++)
+    {
+        int x, y;
+        cellCorner(job, v, x, y);
+        fprintf(out, "cell=%d row=%d column=%d x=%d y=%d", v, v/job.cols,
+                v%job.cols, x, job.height - y - job.thumb);
+        species kind;
+        variantSpecies(job, v, kind);
+        for (int a=0; a<(int)job.axes.size(); a++)
+        {
+            const sweepParam &param = sweep_params[job.axes[a].param];
+            const char *field = (const char *)&kind + param.offset;
+            if (param.integer)
+                fprintf(out, " %s=%d", param.name, *(const int *)field);
+            else
+                fprintf(out, " %s=%.9g", param.name, *(const float *)field);
+        }
+        const sweepResult &r = job.results[v];
+        if (r.status == SWEEP_DONE)
+            fprintf(out, " nodes=%d cones=%d\n", r.nodes, r.cones);
+        else
+            fprintf(out, " failed\n");
+    }
+    bool ok = !ferror(out);
+    return fclose(out) == 0 && ok;
+}
+
+/* Grow every combination of parameters and write a contact sheet */
+int sweepMain(int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        fprintf(stderr, "usage: plant-grow --sweep <sheet.bmp> [options] "
+                "<name>=<from>:<to>:<steps> ...\n");
+        return 2;
+    }
+    sweepJob job;
+    job.seed = time(0);
+    job.time = 8;
+    job.thumb = 160;
+    job.cols = 0;
+    int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i=1; i<argc; i++)
+    {
+        bool more = i+1 < argc;
+        sweepAxis axis;
+        if (strcmp(argv[i], "--seed") == 0 && more)
+            job.seed = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--time") == 0 && more)
+            job.time = atof(argv[++i]);
+        else if (strcmp(argv[i], "--thumb") == 0 && more)
+            job.thumb = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--jobs") == 0 && more)
+            jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--columns") == 0 && more)
+            job.cols = atoi(argv[++i]);
+        else if (parseAxis(argv[i], axis))
+            job.axes.push_back(axis);
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (job.thumb < 1 || jobs < 1 || job.cols < 0 || job.time < 1)
+    {
+        fprintf(stderr, "bad sweep parameters\n");
+        return 2;
+    }
+
+    /* Check each axis against what is left before multiplying, so a huge
+       count of steps can't overflow past the limit */
+    int variants = 1;
+    for (int a=0; a<(int)job.axes.size(); a++)
+    {
+        if (job.axes[a].steps > SWEEP_MAX/variants)
+        {
+            fprintf(stderr, "more than %d variants\n", SWEEP_MAX);
+            return 2;
+        }
+        variants *= job.axes[a].steps;
+    }
+
+    /* Rows are the values of the last parameter unless told otherwise */
+    if (job.cols == 0 && job.axes.size() > 1)
+        job.cols = job.axes.back().steps;
+    if (job.cols == 0)
+        job.cols = (int)ceil(sqrt((double)variants));
+    job.cols = std::min(job.cols, variants);
+    job.rows = (variants + job.cols - 1)/job.cols;
+    if (SWEEP_GAP + std::max(job.cols, job.rows)*
+        ((long long)job.thumb + SWEEP_GAP) > SWEEP_SIDE)
+    {
+        fprintf(stderr, "sheet wider than %d pixels\n", SWEEP_SIDE);
+        return 2;
+    }
+    job.width = SWEEP_GAP + job.cols*(job.thumb + SWEEP_GAP);
+    job.height = SWEEP_GAP + job.rows*(job.thumb + SWEEP_GAP);
+
+    /* Sheet and results are shared so children can fill them in */
+    size_t sheet_bytes = 3*(size_t)job.width*job.height;
+    size_t bytes = sheet_bytes + variants*sizeof(sweepResult);
+    void *shared = mmap(NULL, bytes, PROT_READ|PROT_WRITE,
+                        MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+    {
+        fprintf(stderr, "sheet too big\n");
+        return 1;
+    }
+    job.rgb = (unsigned char *)shared;
+    job.results = (sweepResult *)(job.rgb + sheet_bytes);
+    memset(shared, 0x20, sheet_bytes);
+
+    /* Keep one child growing a variant per job */
+    double start = wallTime();
+    std::map<pid_t, int> running;
+    int next = 0, done = 0, failed = 0;
+    while (next < variants || !running.empty())
+    {
+        if (next < variants && (int)running.size() < jobs)
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                renderVariant(job, next);
+                _exit(0);
+            }
+            if (pid > 0)
+            {
+                running[pid] = next++;
+                continue;
+            }
+            if (running.empty())
+            {
+                perror("fork");
+                return 1;
+            }
+        }
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0 || running.count(pid) == 0)
+            continue;
+        int v = running[pid];
+        running.erase(pid);
+        if (job.results[v].status != SWEEP_DONE)
+        {
+            const unsigned char red[3] = {0x80, 0x10, 0x10};
+            fillCell(job, v, red);
+            failed++;
+        }
+        if (++done % job.cols == 0 || done == variants)
+            fprintf(stderr, "%s: %d of %d variants\n", argv[0], done,
+                    variants);
+    }
+
+    std::string sheet = argv[0];
+    std::string index = sheet;
+    if (index.size() > 4 && index.compare(index.size()-4, 4, ".bmp") == 0)
+        index.erase(index.size()-4);
+    index += ".index";
+    FILE *out = fopen(sheet.c_str(), "wb");
+    if (out == NULL)
+    {
+        fprintf(stderr, "%s: can't write sheet\n", sheet.c_str());
+        return 1;
+    }
+    fclose(out);
+    writeBMP((char *)sheet.c_str(), job.width, job.height, job.rgb);
+    if (!writeIndex(index, job, variants))
+    {
+        fprintf(stderr, "%s: can't write index\n", index.c_str());
+        return 1;
+    }
+    fprintf(stderr, "%d variants in %.1f seconds, %d failed\n", variants,
+            wallTime() - start, failed);
+    munmap(shared, bytes);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+/******************************************************************************
+ *    File : sweep.h
+ * Descrip : Header file for parameter sweeps, a contact sheet of plants
+ *           grown with every combination of a range of branching parameters
+ *****************************************************************************/
+
+#pragma once
+
+/* Procedure prototypes */
+int sweepMain(int argc, char** argv);